@@ -0,0 +1,134 @@
+#ifndef SAM_B_BATCH_HPP
+#define SAM_B_BATCH_HPP 1
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SPGL/SPGL/SPGL.hpp"
+#include "constants.hpp"
+#include "scene.hpp"
+#include "trace.hpp"
+
+namespace sb {
+
+    // Write an image as a binary PPM, returns false if the file could not be written
+    inline bool writePPM(const SPGL::Image& image, const std::string& path) {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if(file == nullptr) return false;
+
+        std::fprintf(file, "P6\n%zu %zu\n255\n", std::size_t(image.width()), std::size_t(image.height()));
+
+        std::vector<unsigned char> row(3 * image.width());
+        bool ok = true;
+        for(SPGL::Size y = 0; y < image.height() && ok; ++y) {
+            for(SPGL::Size x = 0; x < image.width(); ++x) {
+                const SPGL::Color& c = image(x, y);
+                row[3 * x + 0] = c.r;
+                row[3 * x + 1] = c.g;
+                row[3 * x + 2] = c.b;
+            }
+            ok = std::fwrite(row.data(), 1, row.size(), file) == row.size();
+        }
+
+        return (std::fclose(file) == 0) && ok;
+    }
+
+    // Renders an animation with many frames in flight at once. The work is
+    // split into (frame, band of rows) jobs that every thread pulls from in
+    // frame order, so there is no barrier between frames. Each frame borrows
+    // a Scene (camera + image) from a pool of BATCH_FRAMES_IN_FLIGHT slots,
+    // which is handed back once the main thread has written it to disk.
+    //
+    // pose(frame, camera) sets up the camera for a frame, and frames are
+    // written to prefix + frame number + ".ppm" in order.
+    template<typename Pose>
+    bool renderAnimation(const Scene& scene, const int frames, const Pose& pose, const std::string& prefix) {
+        struct Slot {
+            Scene scene;
+            int frame;
+            int remaining;
+        };
+
+        const int bands = (scene.image.height() + BATCH_BAND_ROWS - 1) / BATCH_BAND_ROWS;
+        const int jobs = frames * bands;
+
+        std::vector<Slot> slots(BATCH_FRAMES_IN_FLIGHT, Slot{scene, -1, 0});
+        std::atomic<int> next_job{0};
+        int written = 0;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        std::thread threads[THREADS];
+        for(int g = 0; g < THREADS; ++g) {
+            threads[g] = std::thread([&, g]() {
+                SB_TRACE_THREAD(g + 1);
+                for(int job = next_job++; job < jobs; job = next_job++) {
+                    const int frame = job / bands;
+                    const int band = job % bands;
+                    Slot& slot = slots[frame % BATCH_FRAMES_IN_FLIGHT];
+
+                    {
+                        // Wait for the frame that used this slot before to be written
+                        std::unique_lock<std::mutex> lock(mutex);
+                        cv.wait(lock, [&]() { return frame < written + BATCH_FRAMES_IN_FLIGHT; });
+
+                        if(slot.frame != frame) {
+                            slot.frame = frame;
+                            slot.remaining = bands;
+                            pose(frame, slot.scene.camera);
+                        }
+                    }
+
+                    SB_TRACE_SPAN("band", frame);
+                    const SPGL::Size end = std::min(SPGL::Size(band + 1) * BATCH_BAND_ROWS, slot.scene.image.height());
+                    for(SPGL::Size y = SPGL::Size(band) * BATCH_BAND_ROWS; y < end; ++y) {
+                        for(SPGL::Size x = 0; x < slot.scene.image.width(); ++x) {
+                            slot.scene.updatePixel(x, y);
+                        }
+                    }
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(--slot.remaining == 0) {
+                        cv.notify_all();
+                    }
+                }
+            });
+        }
+
+        bool ok = true;
+        for(int frame = 0; frame < frames; ++frame) {
+            Slot& slot = slots[frame % BATCH_FRAMES_IN_FLIGHT];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return slot.frame == frame && slot.remaining == 0; });
+            }
+
+            SB_TRACE_SPAN("write", frame);
+            char number[16];
+            std::snprintf(number, sizeof(number), "%05d", frame);
+            if(!writePPM(slot.scene.image, prefix + number + ".ppm")) {
+                std::fprintf(stderr, "Unable to write frame %d to %s%s.ppm\n", frame, prefix.c_str(), number);
+                ok = false;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ++written;
+            cv.notify_all();
+        }
+
+        for(auto& t : threads) {
+            t.join();
+        }
+
+        return ok;
+    }
+
+}
+
+#endif
@@ -27,6 +27,23 @@ namespace sb {
             , _pos{Vec3d(1, 1, 1)}
             , _dir{(-_pos).norm()} {}
     
+    public: // Getters
+        Vec3d pos() const {
+            return _pos;
+        }
+
+        std::size_t width() const {
+            return _width;
+        }
+
+        std::size_t height() const {
+            return _height;
+        }
+
+        FloatT fov() const {
+            return FloatT(360.0) * std::atan(_fov_mul) / FloatT(SPGL::Math::Pi);
+        }
+
     public: // Functions
         void setFov(FloatT fov) {
             _fov_mul = std::tan(SPGL::Math::Pi * fov / 360.0);
@@ -37,7 +54,7 @@ namespace sb {
             _dir = (-pos).norm();
         }
 
-        Ray operator()(const std::size_t x, const std::size_t y) const {
+        Ray operator()(const FloatT x, const FloatT y) const {
             // These vectors are all at 90 degrees from eachother
             // We can prove this by taking the dot product between theme    
             //
@@ -61,14 +78,33 @@ namespace sb {
             const Vec3d x_dir = Vec3d( dir.z, 0, -dir.x ).norm();
             const Vec3d y_dir = Vec3d( dir.y * dir.x, -(dir.z * dir.z + dir.x * dir.x), dir.y * dir.z).norm(); 
 
-            FloatT dx = _fov_mul * 2.0 * ((FloatT(x) / FloatT(_width)) - 0.5) * FloatT(_width) / FloatT(_height);
-            FloatT dy = _fov_mul * 2.0 * ((FloatT(y) / FloatT(_height)) - 0.5);
+            FloatT dx = _fov_mul * 2.0 * ((x / FloatT(_width)) - 0.5) * FloatT(_width) / FloatT(_height);
+            FloatT dy = _fov_mul * 2.0 * ((y / FloatT(_height)) - 0.5);
 
             return Ray(
                 _pos, (_dir + dx * x_dir + dy * y_dir).norm()
             );
         }
 
+        // Inverse of operator(), finds the pixel a point in the world lands on.
+        // Returns false if the point is behind the camera
+        bool project(const Vec3d& point, FloatT& x, FloatT& y) const {
+            const Vec3d dir = _dir;
+            const Vec3d x_dir = Vec3d( dir.z, 0, -dir.x ).norm();
+            const Vec3d y_dir = Vec3d( dir.y * dir.x, -(dir.z * dir.z + dir.x * dir.x), dir.y * dir.z).norm(); 
+
+            const Vec3d rel = point - _pos;
+            const FloatT depth = rel.dot(dir);
+            if(depth <= 0) return false;
+
+            const FloatT dx = rel.dot(x_dir) / depth;
+            const FloatT dy = rel.dot(y_dir) / depth;
+
+            x = (dx * FloatT(_height) / (_fov_mul * 2.0 * FloatT(_width)) + 0.5) * FloatT(_width);
+            y = (dy / (_fov_mul * 2.0) + 0.5) * FloatT(_height);
+            return true;
+        }
+
     };
 
 }
@@ -0,0 +1,167 @@
+#ifndef SAM_B_CHECKERBOARD_HPP
+#define SAM_B_CHECKERBOARD_HPP 1
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "SPGL/SPGL/SPGL.hpp"
+#include "constants.hpp"
+#include "camera.hpp"
+#include "color.hpp"
+#include "parallel.hpp"
+#include "scene.hpp"
+
+namespace sb {
+
+    // Marches half of the pixels every frame in an alternating checkerboard.
+    // The other half are reprojected from the previous frame through its
+    // camera, or interpolated from their neighbours if that is rejected.
+    class Checkerboard {
+    private: // Variables
+        SPGL::Size _width, _height;
+
+        std::vector<Sample> _current;
+        std::vector<Sample> _previous;
+
+        // Camera the previous frame was rendered with
+        Camera _camera;
+
+        int _frame;
+        bool _valid;
+
+        // True if the previous frame marched every pixel, not just half
+        bool _previous_full;
+
+        // Fraction of the pixels the last step() marched
+        FloatT _coverage;
+
+    public: // Constructor
+        Checkerboard(SPGL::Size width, SPGL::Size height)
+            : _width{width}, _height{height}
+            , _current(width * height), _previous(width * height)
+            , _camera{Camera(width, height)}
+            , _frame{0}, _valid{false}, _previous_full{false}, _coverage{1} {}
+
+    public: // Getters
+        FloatT coverage() const {
+            return _coverage;
+        }
+
+    public: // Functions
+        // Forget the previous frame, the next step() marches every pixel
+        void reset() {
+            _valid = false;
+        }
+
+        void step(Scene& scene) {
+            const SPGL::Size parity = _frame & 1;
+            _coverage = _valid ? FloatT(0.5) : FloatT(1);
+
+            parallelFor(_height, [&](int y) {
+                for(SPGL::Size x = 0; x < _width; ++x) {
+                    if(!_valid || ((x + y + parity) & 1) == 0) {
+                        _current[index(x, y)] = scene.getSample(x, y);
+                    }
+                }
+            });
+
+            if(_valid) {
+                parallelFor(_height, [&](int y) {
+                    for(SPGL::Size x = 0; x < _width; ++x) {
+                        if(((x + y + parity) & 1) != 0) {
+                            _current[index(x, y)] = reconstruct(scene, x, y);
+                        }
+                    }
+                });
+            }
+
+            parallelFor(_height, [&](int y) {
+                for(SPGL::Size x = 0; x < _width; ++x) {
+                    scene.image(x, y) = _current[index(x, y)].color;
+                }
+            });
+
+            std::swap(_current, _previous);
+            _camera = scene.camera;
+            _previous_full = !_valid;
+            _valid = true;
+            ++_frame;
+        }
+
+    private: // Helper Functions
+        SPGL::Size index(SPGL::Size x, SPGL::Size y) const {
+            return y * _width + x;
+        }
+
+        // Every neighbour of a skipped pixel was marched this frame
+        Sample reconstruct(const Scene& scene, SPGL::Size x, SPGL::Size y) const {
+            Sample n[4];
+            int count = 0;
+            if(0 < x)            n[count++] = _current[index(x - 1, y)];
+            if(0 < y)            n[count++] = _current[index(x, y - 1)];
+            if(x + 1 < _width)   n[count++] = _current[index(x + 1, y)];
+            if(y + 1 < _height)  n[count++] = _current[index(x, y + 1)];
+
+            Vec3d radiance;
+            int steps = 0, hits = 0;
+            FloatT near = MAX_DISTANCE, far = 0, distance = 0;
+            for(int i = 0; i < count; ++i) {
+                radiance += n[i].radiance;
+                steps += n[i].steps;
+                if(n[i].hit) {
+                    near = std::min(near, n[i].distance);
+                    far = std::max(far, n[i].distance);
+                    distance += n[i].distance;
+                    ++hits;
+                }
+            }
+
+            const Sample spatial = Sample{
+                toColor(radiance / FloatT(count)), 
+                radiance / FloatT(count),
+                hits ? distance / hits : MAX_DISTANCE, 
+                steps / count, 
+                2 * hits > count
+            };
+
+            // Only reproject when the neighbours agree on a single surface
+            if(hits < count || REPROJECT_TOLERANCE * near < far - near) {
+                return spatial;
+            }
+
+            const Ray ray = scene.camera(x, y);
+            const Vec3d point = ray.pos() + ray.dir() * spatial.distance;
+
+            FloatT px, py;
+            if(!_camera.project(point, px, py)) {
+                return spatial;
+            }
+
+            const long ix = std::lround(px);
+            const long iy = std::lround(py);
+            if(ix < 0 || iy < 0 || long(_width) <= ix || long(_height) <= iy) {
+                return spatial;
+            }
+
+            // Only trust pixels the previous frame marched, reusing its
+            // reconstructed ones would smear colors over several frames
+            const SPGL::Size previous_parity = (_frame + 1) & 1;
+            if(!_previous_full && ((ix + iy + previous_parity) & 1) != 0) {
+                return spatial;
+            }
+
+            // Reject if the previous frame saw something else at that spot
+            const Sample& prev = _previous[index(ix, iy)];
+            const FloatT expected = (point - _camera.pos()).mag();
+            if(!prev.hit || REPROJECT_TOLERANCE * expected < std::abs(prev.distance - expected)) {
+                return spatial;
+            }
+
+            return Sample{prev.color, prev.radiance, spatial.distance, prev.steps, true};
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef SAM_B_COLOR_HPP
+#define SAM_B_COLOR_HPP 1
+
+#include <algorithm>
+#include <cmath>
+
+#include "SPGL/SPGL/SPGL.hpp"
+#include "constants.hpp"
+#include "vec3.hpp"
+
+namespace sb {
+
+    // Colors are accumulated as Vec3d in the 0-255 range so that
+    // averaging many samples does not lose precision or clip early
+    inline Vec3d toVec(const SPGL::Color& c) {
+        return Vec3d(c.r, c.g, c.b);
+    }
+
+    inline SPGL::Color toColor(const Vec3d& v) {
+        return SPGL::Color(
+            int(std::clamp(v.x + FloatT(0.5), FloatT(0), FloatT(255))),
+            int(std::clamp(v.y + FloatT(0.5), FloatT(0), FloatT(255))),
+            int(std::clamp(v.z + FloatT(0.5), FloatT(0), FloatT(255)))
+        );
+    }
+
+    // Sum of the absolute channel differences
+    inline FloatT colorDiff(const SPGL::Color& a, const SPGL::Color& b) {
+        const Vec3d d = (toVec(a) - toVec(b)).abs();
+        return d.x + d.y + d.z;
+    }
+
+}
+
+#endif
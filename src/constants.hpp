@@ -37,6 +37,75 @@ namespace sb {
     constexpr int HEIGHT = 480;
 
     constexpr int PIXELS = WIDTH*HEIGHT;
+
+    // Frame time the interactive loop tries to hold (in milliseconds)
+    constexpr FloatT TARGET_FRAME_MS = 50;
+
+    // Largest pixel stride the governor may fall back to when frames run long
+    constexpr int MAX_STRIDE = 8;
+
+    // How much of the previous frame time estimate is kept each frame
+    constexpr FloatT GOVERNOR_SMOOTHING = 0.75;
+
+    // Grid spacing of the first progressive pass (must be a power of two)
+    constexpr int PROGRESSIVE_STRIDE = 8;
+
+    // Samples an edge pixel ends up with once progressive rendering is done
+    constexpr int PROGRESSIVE_SAMPLES = 8;
+
+    // How far apart neighbouring samples can be before they get refined
+    constexpr FloatT REFINE_COLOR_DIFF = 24;
+    constexpr FloatT REFINE_DISTANCE_RATIO = 0.1;
+    constexpr int REFINE_STEP_DIFF = 16;
+
+    // Render half the pixels per frame while moving and reconstruct the rest
+    constexpr bool CHECKERBOARD = true;
+
+    // Relative depth difference allowed when reusing the previous frame
+    constexpr FloatT REPROJECT_TOLERANCE = 0.05;
+
+    // Frames a batch render may have in flight (each one holds an image)
+    constexpr int BATCH_FRAMES_IN_FLIGHT = 8;
+
+    // Rows of a frame each batch job renders
+    constexpr int BATCH_BAND_ROWS = 16;
+
+    // Width and height of the tiles handed out to distributed workers
+    constexpr int DISTRIBUTED_TILE = 64;
+
+    // Seconds before a tile that has not come back is also given to an idle worker
+    constexpr FloatT DISTRIBUTED_TILE_TIMEOUT = 5;
+
+    // Seconds a peer may stall in the middle of a message before it is dropped
+    constexpr int DISTRIBUTED_IO_TIMEOUT = 2;
+
+    // Seconds a worker waits for the coordinator before giving up on it
+    constexpr int DISTRIBUTED_WORKER_TIMEOUT = 60;
+
+    // Largest message payload accepted from a peer, scenes included
+    constexpr std::size_t DISTRIBUTED_MAX_MESSAGE = std::size_t(1) << 26;
+
+    // Events each thread may record when built with SB_TRACE, and where they are written
+    constexpr std::size_t TRACE_BUFFER_EVENTS = 1 << 18;
+    constexpr const char* TRACE_FILE = "marcher_trace.json";
+
+    // Reuse shadow rays between frames, only valid while the scene and lights stay still.
+    // Trades exact shadows for speed: every point in a cell shares the answer of
+    // whichever thread marched it first, so shadow edges shift and can differ between runs
+    constexpr bool SHADOW_CACHE = false;
+
+    // Size of the world space cells shadow visibility is stored for. Each frame of an
+    // orbit lands on mostly new cells, so expect few hits: on the orbit scene at 240x160
+    // about 4% of lookups hit on the first frame, rising to about 30% by the eighth
+    // (21% overall, 15% less render time). 0.2 reaches about 70% but visibly moves edges
+    constexpr FloatT SHADOW_CACHE_CELL = 0.1;
+
+    // Max number of (cell, light) pairs remembered (12 bytes each), and how many share a set
+    constexpr std::size_t SHADOW_CACHE_ENTRIES = 1 << 22;
+    constexpr std::size_t SHADOW_CACHE_WAYS = 4;
+
+    // How far the camera orbits each frame, 0 holds the camera still
+    constexpr FloatT ORBIT_SPEED = 0.1;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,448 @@
+#ifndef SAM_B_DISTRIBUTED_HPP
+#define SAM_B_DISTRIBUTED_HPP 1
+
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "SPGL/SPGL/SPGL.hpp"
+#include "constants.hpp"
+#include "camera.hpp"
+#include "light.hpp"
+#include "loader.hpp"
+#include "net.hpp"
+#include "parallel.hpp"
+#include "scene.hpp"
+#include "trace.hpp"
+
+namespace sb {
+
+    // Every message is a header followed by `size` bytes of payload.
+    // Values are sent in host byte order, so all machines must share an architecture.
+    enum class Message : std::uint32_t {
+        Hello,  // worker -> coordinator, worker is ready
+        Frame,  // coordinator -> worker, constants, scene, camera and lights
+        Tile,   // coordinator -> worker, id x y w h
+        Result, // worker -> coordinator, id x y w h then w * h rgb pixels
+        Done    // coordinator -> worker, shut down
+    };
+
+    class Packet {
+    private: // Variables
+        std::vector<char> _data;
+        std::size_t _read = 0;
+        bool _ok = true;
+
+    public: // Getters
+        std::vector<char>& data() {
+            return _data;
+        }
+
+        const std::vector<char>& data() const {
+            return _data;
+        }
+
+        // False if a get() ran past the end of the payload
+        bool ok() const {
+            return _ok;
+        }
+
+        // Bytes not read yet, check counts against this before allocating
+        std::size_t remaining() const {
+            return _data.size() - _read;
+        }
+
+    public: // Functions
+        void putBytes(const void* bytes, std::size_t size) {
+            const char* begin = static_cast<const char*>(bytes);
+            _data.insert(_data.end(), begin, begin + size);
+        }
+
+        bool getBytes(void* bytes, std::size_t size) {
+            if(_data.size() < _read + size) return _ok = false;
+            std::memcpy(bytes, _data.data() + _read, size);
+            _read += size;
+            return true;
+        }
+
+        template<typename T>
+        Packet& put(const T& value) {
+            putBytes(&value, sizeof(T));
+            return *this;
+        }
+
+        template<typename T>
+        T get() {
+            T value{};
+            getBytes(&value, sizeof(T));
+            return value;
+        }
+    };
+
+    inline bool sendMessage(const Socket& socket, Message type, const Packet& packet = Packet()) {
+        const std::uint32_t header[2] = { std::uint32_t(type), std::uint32_t(packet.data().size()) };
+        return socket.sendAll(header, sizeof(header)) 
+            && socket.sendAll(packet.data().data(), packet.data().size());
+    }
+
+    // Fails on messages larger than max_size instead of allocating whatever the peer asks for
+    inline bool recvMessage(const Socket& socket, Message& type, Packet& packet, std::size_t max_size = DISTRIBUTED_MAX_MESSAGE) {
+        std::uint32_t header[2];
+        if(!socket.recvAll(header, sizeof(header))) return false;
+        if(max_size < header[1]) return false;
+
+        type = Message(header[0]);
+        packet = Packet();
+        packet.data().resize(header[1]);
+        return socket.recvAll(packet.data().data(), header[1]);
+    }
+
+    // Workers refuse frames rendered with different compile time settings
+    inline std::uint64_t constantsFingerprint() {
+        Packet p;
+        p.put(std::uint32_t(sizeof(FloatT)))
+         .put(MAX_HITS).put(MAX_MARCH_ITER).put(MAX_MARCH_ITER_LIGHTING)
+         .put(EPS).put(NORM_EPS).put(LIGHTING_EPS).put(FIXING_RATIO).put(MAX_DISTANCE)
+         .put(AMBIENT_COLOR.r).put(AMBIENT_COLOR.g).put(AMBIENT_COLOR.b);
+
+        // FNV-1a
+        std::uint64_t hash = 14695981039346656037ull;
+        for(const char c : p.data()) {
+            hash = (hash ^ std::uint8_t(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // source is the scene file the coordinator loaded, empty if it uses the built in scene
+    inline Packet frameMessage(const Scene& scene, const SceneBuffer& source) {
+        Packet p;
+        p.put(constantsFingerprint());
+
+        p.put(std::uint64_t(source.size()));
+        p.putBytes(source.data(), source.size());
+
+        const Camera& c = scene.camera;
+        p.put(std::uint32_t(c.width())).put(std::uint32_t(c.height()))
+         .put(c.pos().x).put(c.pos().y).put(c.pos().z).put(c.fov());
+
+        p.put(std::uint32_t(scene.lights.size()));
+        for(const Light& l : scene.lights) {
+            p.put(l.pos().x).put(l.pos().y).put(l.pos().z)
+             .put(l.color().r).put(l.color().g).put(l.color().b)
+             .put(l.brightness());
+        }
+
+        return p;
+    }
+
+    // own is the scene file this process loaded, empty if it uses the built in scene
+    inline bool applyFrameMessage(Scene& scene, Packet& p, const SceneBuffer& own) {
+        if(p.get<std::uint64_t>() != constantsFingerprint()) {
+            std::fprintf(stderr, "Coordinator was built with different constants\n");
+            return false;
+        }
+
+        const std::uint64_t size = p.get<std::uint64_t>();
+        if(p.remaining() < size) return false;
+
+        // Without a scene from the coordinator both sides must use the built in one
+        if(size == 0 && !own.empty()) {
+            std::fprintf(stderr, "Coordinator uses the built in scene, but this worker loaded one\n");
+            return false;
+        }
+
+        if(0 < size) {
+            std::vector<char> bytes(size);
+            if(!p.getBytes(bytes.data(), size)) return false;
+
+            const SceneBuffer source = SceneBuffer::copy(bytes.data(), size);
+            if(!source.validate()) {
+                std::fprintf(stderr, "Coordinator sent an invalid scene\n");
+                return false;
+            }
+            buildScene(source, scene);
+        }
+
+        const std::uint32_t width = p.get<std::uint32_t>();
+        const std::uint32_t height = p.get<std::uint32_t>();
+        const FloatT x = p.get<FloatT>(), y = p.get<FloatT>(), z = p.get<FloatT>();
+        scene.camera = Camera(width, height, p.get<FloatT>());
+        scene.camera.setPos(Vec3d(x, y, z));
+
+        const std::uint32_t count = p.get<std::uint32_t>();
+        const std::size_t light_size = 4 * sizeof(FloatT) + 3 * sizeof(AMBIENT_COLOR.r);
+        if(p.remaining() / light_size < count) return false;
+
+        std::vector<Light> lights(count, Light(Vec3d()));
+        for(Light& l : lights) {
+            const FloatT lx = p.get<FloatT>(), ly = p.get<FloatT>(), lz = p.get<FloatT>();
+            const auto r = p.get<decltype(AMBIENT_COLOR.r)>();
+            const auto g = p.get<decltype(AMBIENT_COLOR.g)>();
+            const auto b = p.get<decltype(AMBIENT_COLOR.b)>();
+            l = Light(Vec3d(lx, ly, lz), SPGL::Color(r, g, b), p.get<FloatT>());
+        }
+        scene.lights = lights;
+        if(scene.shadows) scene.shadows->clear();
+
+        return p.ok();
+    }
+
+    // Connect to a coordinator and render tiles until it says we are done.
+    // If the coordinator did not load a scene file, the worker must not have loaded one either.
+    inline bool work(Scene& scene, const std::string& address, const SceneBuffer& source = SceneBuffer()) {
+        std::signal(SIGPIPE, SIG_IGN);
+
+        // A coordinator that dies or never accepts us must not leave us waiting forever
+        const Socket socket = Socket::connect(address);
+        if(!socket.valid() || !socket.setTimeout(DISTRIBUTED_WORKER_TIMEOUT) || !sendMessage(socket, Message::Hello)) {
+            std::fprintf(stderr, "Unable to connect to %s\n", address.c_str());
+            return false;
+        }
+
+        Message type;
+        Packet packet;
+        while(recvMessage(socket, type, packet)) {
+            if(type == Message::Done) {
+                return true;
+            } else if(type == Message::Frame) {
+                if(!applyFrameMessage(scene, packet, source)) return false;
+            } else if(type == Message::Tile) {
+                const auto id = packet.get<std::uint32_t>();
+                const auto x = packet.get<std::uint32_t>(), y = packet.get<std::uint32_t>();
+                const auto w = packet.get<std::uint32_t>(), h = packet.get<std::uint32_t>();
+                if(!packet.ok() || DISTRIBUTED_TILE < w || DISTRIBUTED_TILE < h) return false;
+
+                SB_TRACE_SPAN("tile", id);
+                std::vector<std::uint8_t> pixels(3 * w * h);
+                parallelFor(h, [&](int row) {
+                    for(std::uint32_t col = 0; col < w; ++col) {
+                        const SPGL::Color c = scene.getPixel(x + col, y + row);
+                        std::uint8_t* out = &pixels[3 * (row * w + col)];
+                        out[0] = c.r; out[1] = c.g; out[2] = c.b;
+                    }
+                });
+
+                Packet result;
+                result.put(id).put(x).put(y).put(w).put(h);
+                result.putBytes(pixels.data(), pixels.size());
+                if(!sendMessage(socket, Message::Result, result)) return false;
+            }
+        }
+
+        return false;
+    }
+
+    // Split scene.image into tiles and hand them out to every worker that
+    // connects to address. Tiles from workers that disconnect are put back in
+    // the queue, and tiles that have been out for DISTRIBUTED_TILE_TIMEOUT are
+    // also given to idle workers, keeping whichever result comes back first.
+    // local_workers child processes are forked to connect as well.
+    inline bool coordinate(Scene& scene, const std::string& address, int local_workers = 0, const SceneBuffer& source = SceneBuffer()) {
+        using Clock = std::chrono::steady_clock;
+
+        struct Tile {
+            std::uint32_t x, y, w, h;
+            Clock::time_point sent;
+            int copies;
+            bool done;
+        };
+
+        struct Worker {
+            Socket socket;
+            int tile;
+            Clock::time_point sent;
+            int tiles;
+            std::size_t pixels;
+            FloatT seconds;
+        };
+
+        std::signal(SIGPIPE, SIG_IGN);
+
+        Socket listener = Socket::listen(address);
+        if(!listener.valid()) {
+            std::fprintf(stderr, "Unable to listen on %s\n", address.c_str());
+            return false;
+        }
+
+        std::vector<Tile> tiles;
+        std::deque<int> pending;
+        for(SPGL::Size y = 0; y < scene.image.height(); y += DISTRIBUTED_TILE) {
+            for(SPGL::Size x = 0; x < scene.image.width(); x += DISTRIBUTED_TILE) {
+                pending.push_back(tiles.size());
+                tiles.push_back(Tile{
+                    std::uint32_t(x), std::uint32_t(y),
+                    std::uint32_t(std::min<SPGL::Size>(DISTRIBUTED_TILE, scene.image.width() - x)),
+                    std::uint32_t(std::min<SPGL::Size>(DISTRIBUTED_TILE, scene.image.height() - y)),
+                    Clock::time_point(), 0, false
+                });
+            }
+        }
+        std::size_t remaining = tiles.size();
+
+        std::vector<pid_t> children;
+        for(int i = 0; i < local_workers; ++i) {
+            const pid_t pid = ::fork();
+            if(pid == 0) {
+                ::close(listener.fd());
+                const bool ok = work(scene, address, source);
+                SB_TRACE_FLUSH(TRACE_FILE);
+                std::_Exit(ok ? 0 : 1);
+            }
+            if(0 < pid) children.push_back(pid);
+        }
+
+        const Packet frame = frameMessage(scene, source);
+        std::vector<Worker> workers;
+
+        // id x y w h and the pixels of the largest tile
+        const std::size_t max_result = 5 * sizeof(std::uint32_t) + 3 * DISTRIBUTED_TILE * DISTRIBUTED_TILE;
+
+        const auto drop = [&](Worker& worker) {
+            if(0 <= worker.tile && --tiles[worker.tile].copies == 0 && !tiles[worker.tile].done) {
+                pending.push_front(worker.tile);
+            }
+            worker.tile = -1;
+            worker.socket = Socket();
+        };
+
+        const auto assign = [&](Worker& worker) {
+            int tile = -1;
+            if(!pending.empty()) {
+                tile = pending.front();
+                pending.pop_front();
+            } else {
+                // Nothing left to hand out, help with the oldest straggler
+                const Clock::time_point now = Clock::now();
+                for(int i = 0; i < int(tiles.size()); ++i) {
+                    const std::chrono::duration<FloatT> out = now - tiles[i].sent;
+                    if(!tiles[i].done && tiles[i].copies == 1 && DISTRIBUTED_TILE_TIMEOUT < out.count()
+                        && (tile < 0 || tiles[i].sent < tiles[tile].sent)) tile = i;
+                }
+            }
+            if(tile < 0) return;
+
+            Tile& t = tiles[tile];
+            Packet p;
+            p.put(std::uint32_t(tile)).put(t.x).put(t.y).put(t.w).put(t.h);
+
+            worker.tile = tile;
+            worker.sent = Clock::now();
+            if(t.copies++ == 0) t.sent = worker.sent;
+
+            if(!sendMessage(worker.socket, Message::Tile, p)) drop(worker);
+        };
+
+        while(0 < remaining) {
+            SB_TRACE_SPAN("coordinate", remaining);
+            std::vector<pollfd> fds(1, pollfd{listener.fd(), POLLIN, 0});
+            std::vector<int> owners(1, -1);
+            for(int i = 0; i < int(workers.size()); ++i) {
+                if(workers[i].socket.valid()) {
+                    fds.push_back(pollfd{workers[i].socket.fd(), POLLIN, 0});
+                    owners.push_back(i);
+                }
+            }
+
+            if(::poll(fds.data(), fds.size(), 100) < 0) continue;
+
+            for(std::size_t f = 1; f < fds.size(); ++f) {
+                if(fds[f].revents == 0) continue;
+                Worker& worker = workers[owners[f]];
+
+                Message type;
+                Packet p;
+                if(!recvMessage(worker.socket, type, p, max_result)) {
+                    std::fprintf(stderr, "Worker %d disconnected\n", owners[f]);
+                    drop(worker);
+                    continue;
+                }
+                if(type != Message::Result) continue;
+
+                const auto id = p.get<std::uint32_t>();
+                const auto x = p.get<std::uint32_t>(), y = p.get<std::uint32_t>();
+                const auto w = p.get<std::uint32_t>(), h = p.get<std::uint32_t>();
+                if(!p.ok() || tiles.size() <= id || int(id) != worker.tile) {
+                    drop(worker);
+                    continue;
+                }
+
+                // Workers may run anywhere, never trust them with where to write
+                Tile& t = tiles[id];
+                if(x != t.x || y != t.y || w != t.w || h != t.h) {
+                    std::fprintf(stderr, "Worker %d sent a tile that does not match its request\n", owners[f]);
+                    drop(worker);
+                    continue;
+                }
+
+                std::vector<std::uint8_t> pixels(3 * w * h);
+                if(!p.getBytes(pixels.data(), pixels.size())) {
+                    drop(worker);
+                    continue;
+                }
+
+                if(!t.done) {
+                    for(std::uint32_t row = 0; row < h; ++row) {
+                        for(std::uint32_t col = 0; col < w; ++col) {
+                            const std::uint8_t* in = &pixels[3 * (row * w + col)];
+                            scene.image(x + col, y + row) = SPGL::Color(in[0], in[1], in[2]);
+                        }
+                    }
+                    t.done = true;
+                    --remaining;
+                }
+
+                const std::chrono::duration<FloatT> seconds = Clock::now() - worker.sent;
+                worker.tiles += 1;
+                worker.pixels += w * h;
+                worker.seconds += seconds.count();
+
+                --t.copies;
+                worker.tile = -1;
+            }
+
+            if(fds[0].revents != 0) {
+                Socket socket = listener.accept();
+                if(socket.valid() && socket.setTimeout(DISTRIBUTED_IO_TIMEOUT) && sendMessage(socket, Message::Frame, frame)) {
+                    workers.push_back(Worker{std::move(socket), -1, Clock::now(), 0, 0, 0});
+                }
+            }
+
+            for(Worker& worker : workers) {
+                if(worker.socket.valid() && worker.tile < 0) assign(worker);
+            }
+        }
+
+        // Workers still waiting in the backlog are never accepted, closing
+        // the listener resets them so they exit instead of waiting for Done
+        listener = Socket();
+
+        for(Worker& worker : workers) {
+            if(worker.socket.valid()) sendMessage(worker.socket, Message::Done);
+        }
+
+        for(const pid_t pid : children) {
+            ::waitpid(pid, nullptr, 0);
+        }
+
+        for(int i = 0; i < int(workers.size()); ++i) {
+            const Worker& w = workers[i];
+            std::printf("Worker %d: %d tiles, %zu pixels, %.2fs busy, %.3f Mpx/s\n",
+                i, w.tiles, w.pixels, w.seconds, w.seconds > 0 ? w.pixels / w.seconds / 1e6 : 0.0);
+        }
+
+        return true;
+    }
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SAM_B_GOVERNOR_HPP
+#define SAM_B_GOVERNOR_HPP 1
+
+#include <algorithm>
+#include <cmath>
+
+#include "constants.hpp"
+
+namespace sb {
+
+    // Picks the pixel stride used by the interactive loop so that
+    // each frame stays close to TARGET_FRAME_MS. While the camera is
+    // still, the stride walks back down to 1 one step per frame.
+    class Governor {
+    private: // Variables
+        int _stride;
+
+        // Smoothed estimate of what a stride 1 frame would cost
+        FloatT _full_ms;
+
+    public: // Constructor
+        Governor(int stride = 1) 
+            : _stride{std::clamp(stride, 1, MAX_STRIDE)}, _full_ms{0} {}
+
+    public: // Getters
+        int stride() const {
+            return _stride;
+        }
+
+    public: // Functions
+        // Cost scales with the number of pixels marched, so coverage is the
+        // fraction of a full stride 1 frame the measured frame marched
+        void measure(FloatT frame_ms, FloatT coverage) {
+            const FloatT full_ms = frame_ms / coverage;
+            _full_ms = (_full_ms == 0) ? full_ms 
+                : GOVERNOR_SMOOTHING * _full_ms + (FloatT(1.0) - GOVERNOR_SMOOTHING) * full_ms;
+        }
+
+        void update(bool moving) {
+            if(!moving) {
+                _stride = std::max(1, _stride - 1);
+                return;
+            }
+
+            // Smallest stride whose estimated cost fits into the budget
+            const int wanted = std::clamp(
+                int(std::ceil(std::sqrt(_full_ms / TARGET_FRAME_MS))), 1, MAX_STRIDE
+            );
+
+            // Only move one step at a time so the image does not flicker
+            if(wanted < _stride) _stride -= 1;
+            if(wanted > _stride) _stride += 1;
+        }
+    };
+
+}
+
+#endif
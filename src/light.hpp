@@ -13,16 +13,16 @@ namespace sb {
     class Material {
     public:
         // Specularity
-        const FloatT k_s;
+        FloatT k_s;
         
         // Diffusion
-        const FloatT k_d;
+        FloatT k_d;
 
         // Ambiance 
-        const FloatT k_a;
+        FloatT k_a;
 
         // Specularity Amount
-        const FloatT a;
+        FloatT a;
 
     public:
         constexpr Material(FloatT k_s, FloatT k_d, FloatT k_a, FloatT a)
@@ -46,7 +46,21 @@ namespace sb {
         constexpr Light(const Vec3d& pos, const SPGL::Color& color = SPGL::Color(224,224,64), FloatT bright=1.0)
         : _pos{pos}, _color{color}, _bright{bright} {}
 
-    private: // Helper Functions
+    public: // Getters
+        constexpr Vec3d pos() const {
+            return _pos;
+        }
+
+        constexpr SPGL::Color color() const {
+            return _color;
+        }
+
+        constexpr FloatT brightness() const {
+            return _bright;
+        }
+
+    public: // Functions
+        // March a shadow ray from pos, true if nothing is between it and the light
         bool getDirectLight(const SDF& sdf, const Vec3d& pos) const {
             // Get ray from point towards light
             Ray ray = Ray(pos, _pos - pos).fix(sdf, FIXING_RATIO * LIGHTING_EPS);
@@ -68,8 +82,12 @@ namespace sb {
             return false;
         }
 
-    public: // Functions
         SPGL::Color getColor(const SDF& sdf, const Ray& ray, const Material& mat = DEFAULT_MATERIAL) const {
+            return getIntensity(sdf, ray, mat, getDirectLight(sdf, ray.pos())) * _color;
+        }
+
+        // How much of this light's color reaches ray.pos(), without clamping
+        FloatT getIntensity(const SDF& sdf, const Ray& ray, const Material& mat, const bool direct) const {
 
             // Relative Position / Distance
             const Vec3d rel_pos = _pos - ray.pos();
@@ -80,7 +98,7 @@ namespace sb {
             FloatT brightness = mat.k_a;
 
             // If there is direct light, do some more lighting
-            if(getDirectLight(sdf, ray.pos())) {
+            if(direct) {
                 const Vec3d normal = sdf.normal(ray.pos());
                 const Vec3d light_dir = Ray(ray.pos(), -rel_pos).reflect(sdf).dir();
 
@@ -93,8 +111,7 @@ namespace sb {
                 brightness += (FloatT(0.0) + f) * std::pow(std::max(FloatT(0), -(ray.dir().dot(light_dir))), mat.a);
             }
 
-            // Return Color Multiplied by Brightness
-            return (_bright * brightness / dist_sqr) * _color;
+            return _bright * brightness / dist_sqr;
         }
     };
 
@@ -0,0 +1,578 @@
+#ifndef SAM_B_LOADER_HPP
+#define SAM_B_LOADER_HPP 1
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SPGL/SPGL/SPGL.hpp"
+#include "constants.hpp"
+#include "light.hpp"
+#include "mat3.hpp"
+#include "scene.hpp"
+#include "sdf.hpp"
+#include "vec3.hpp"
+
+// Scenes can be written as text and compiled into a binary form that is
+// loaded with mmap and evaluated in place. Both forms share one layout:
+//
+//     SceneHeader | SceneLight * header.lights | SceneNode * header.nodes
+//
+// The nodes are a postfix program over two stacks, one of points and one of
+// distances, so evaluating the SDF is a single loop with no allocations or
+// virtual calls.
+//
+// TEXT FORMAT: whitespace separated tokens, # starts a comment, angles are
+// in degrees. Shapes are written in prefix order.
+//
+//     camera <x> <y> <z> <fov>
+//     material <k_s> <k_d> <k_a> <a>
+//     light <x> <y> <z> <r> <g> <b> <brightness>
+//     sdf <shape>
+//
+//     shape := sphere <r> | box <x> <y> <z> | plane <nx> <ny> <nz> <h>
+//            | cylinder <r> | squilindar <r> | squircle <r>
+//            | invert <shape> | union <n> <shape>... | intersect <n> <shape>...
+//            | subtract <shape> <shape> | inflate <r> <shape>
+//            | translate <x> <y> <z> <shape> | scale <s> <shape>
+//            | stretch <x> <y> <z> <shape> | roll <deg> <shape>
+//            | pitch <deg> <shape> | yaw <deg> <shape>
+//            | matrix <m00> <m01> ... <m22> <shape>
+
+namespace sb {
+
+    constexpr char SCENE_MAGIC[4] = { 'S', 'B', 'S', 'C' };
+    constexpr std::uint32_t SCENE_VERSION = 2;
+
+    enum SceneOp : std::uint32_t {
+        // Push a distance measured from the top point, args 6 7 8 move the shape
+        OP_SPHERE = 0,      // r
+        OP_BOX = 1,         // x y z
+        OP_PLANE = 2,       // nx ny nz h (normalized)
+        OP_CYLINDER = 3,    // r
+        OP_SQUILINDAR = 4,  // r
+        OP_SQUIRCLE = 5,    // r
+
+        // Replace the top distance
+        OP_INVERT = 16,
+        OP_INFLATE = 17,    // r
+
+        // Pop two distances and push one
+        OP_UNION = 32,
+        OP_INTERSECT = 33,
+        OP_SUBTRACT = 34,
+
+        // Push a transformed copy of the top point
+        OP_TRANSLATE = 48,  // x y z
+        OP_LINEAR = 49,     // 3x3 matrix, row major
+
+        // Pop a point and multiply the top distance
+        OP_POP = 64         // factor
+    };
+
+    struct SceneHeader {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t lights;
+        std::uint32_t nodes;
+        FloatT camera[4];   // x y z fov
+        FloatT material[4]; // k_s k_d k_a a
+    };
+
+    struct SceneLight {
+        FloatT pos[3];
+        FloatT color[3];
+        FloatT brightness;
+    };
+
+    struct SceneNode {
+        std::uint32_t op;
+        std::uint32_t reserved;
+        FloatT args[9];
+    };
+
+    // Deepest nesting of transforms and binary operators a scene may use
+    constexpr int SCENE_STACK_DEPTH = 64;
+
+    // Deepest nesting of any shape in the text format, invert and inflate nest without using the stacks
+    constexpr int SCENE_MAX_NESTING = 256;
+
+    // A scene in its binary layout, either mapped from disk or built in memory
+    class SceneBuffer {
+    private: // Variables
+        std::shared_ptr<const char> _data;
+        std::size_t _size = 0;
+
+    public: // Constructors
+        SceneBuffer() = default;
+        SceneBuffer(const std::shared_ptr<const char>& data, std::size_t size)
+            : _data{data}, _size{size} {}
+
+        static SceneBuffer copy(const void* bytes, std::size_t size) {
+            std::shared_ptr<char> data(new char[size], std::default_delete<char[]>());
+            std::memcpy(data.get(), bytes, size);
+            return SceneBuffer(data, size);
+        }
+
+    public: // Getters
+        const char* data() const {
+            return _data.get();
+        }
+
+        std::size_t size() const {
+            return _size;
+        }
+
+        bool empty() const {
+            return _size == 0;
+        }
+
+        const SceneHeader& header() const {
+            return *reinterpret_cast<const SceneHeader*>(data());
+        }
+
+        const SceneLight* lights() const {
+            return reinterpret_cast<const SceneLight*>(data() + sizeof(SceneHeader));
+        }
+
+        const SceneNode* nodes() const {
+            return reinterpret_cast<const SceneNode*>(lights() + header().lights);
+        }
+
+        // Keeps the buffer alive for as long as the SDF built from it
+        const std::shared_ptr<const char>& owner() const {
+            return _data;
+        }
+
+    public: // Functions
+        // Check that a buffer from an untrusted source is safe to evaluate
+        bool validate() const {
+            if(_size < sizeof(SceneHeader)
+                || std::memcmp(header().magic, SCENE_MAGIC, 4) != 0
+                || header().version != SCENE_VERSION) return false;
+
+            const std::size_t expected = sizeof(SceneHeader)
+                + std::size_t(header().lights) * sizeof(SceneLight)
+                + std::size_t(header().nodes) * sizeof(SceneNode);
+            if(_size != expected) return false;
+
+            int points = 1, values = 0;
+            for(std::uint32_t i = 0; i < header().nodes; ++i) {
+                switch(nodes()[i].op) {
+                    case OP_SPHERE: case OP_BOX: case OP_PLANE:
+                    case OP_CYLINDER: case OP_SQUILINDAR: case OP_SQUIRCLE:
+                        values += 1; break;
+                    case OP_INVERT: case OP_INFLATE:
+                        if(values < 1) return false;
+                        break;
+                    case OP_UNION: case OP_INTERSECT: case OP_SUBTRACT:
+                        if(values < 2) return false;
+                        values -= 1; break;
+                    case OP_TRANSLATE: case OP_LINEAR:
+                        points += 1; break;
+                    case OP_POP:
+                        if(points < 2 || values < 1) return false;
+                        points -= 1; break;
+                    default:
+                        return false;
+                }
+                if(SCENE_STACK_DEPTH < points || SCENE_STACK_DEPTH < values) return false;
+            }
+
+            return points == 1 && values == 1;
+        }
+    };
+
+    // Evaluates the node program of a validated SceneBuffer
+    class SceneProgram {
+    private: // Variables
+        SceneBuffer _buffer;
+        const SceneNode* _nodes;
+        const SceneNode* _end;
+
+    public: // Constructor
+        SceneProgram(const SceneBuffer& buffer)
+            : _buffer{buffer}, _nodes{buffer.nodes()}, _end{buffer.nodes() + buffer.header().nodes} {}
+
+    public: // Functions
+        FloatT operator()(const Vec3d& pos) const {
+            // The top point and distance stay in locals, the arrays only hold what is
+            // below them. They are left uninitialized, this runs for every SDF sample.
+            FloatT x = pos.x, y = pos.y, z = pos.z, top = 0;
+            FloatT xs[SCENE_STACK_DEPTH], ys[SCENE_STACK_DEPTH], zs[SCENE_STACK_DEPTH];
+            FloatT values[SCENE_STACK_DEPTH];
+            int p = 0, v = 0;
+
+            for(const SceneNode* n = _nodes; n != _end; ++n) {
+                const FloatT* a = n->args;
+                const auto at = [&]() { return Vec3d(x - a[6], y - a[7], z - a[8]); };
+                switch(n->op) {
+                    case OP_SPHERE:     values[v++] = top; top = SDF::sphere(at(), a[0]); break;
+                    case OP_BOX:        values[v++] = top; top = SDF::box(at(), Vec3d(a[0], a[1], a[2])); break;
+                    case OP_PLANE:      values[v++] = top; top = SDF::plane(at(), Vec3d(a[0], a[1], a[2]), a[3]); break;
+                    case OP_CYLINDER:   values[v++] = top; top = SDF::cylinder(at(), a[0]); break;
+                    case OP_SQUILINDAR: values[v++] = top; top = SDF::squilindar(at(), a[0]); break;
+                    case OP_SQUIRCLE:   values[v++] = top; top = SDF::squircle(at(), a[0]); break;
+
+                    case OP_INVERT:     top = -top; break;
+                    case OP_INFLATE:    top -= a[0]; break;
+
+                    case OP_UNION:      top = std::min(values[--v], top); break;
+                    case OP_INTERSECT:  top = std::max(values[--v], top); break;
+                    case OP_SUBTRACT:   top = std::max(values[--v], -top); break;
+
+                    case OP_TRANSLATE:
+                        xs[p] = x; ys[p] = y; zs[p] = z; ++p;
+                        x -= a[0]; y -= a[1]; z -= a[2];
+                        break;
+                    case OP_LINEAR: {
+                        xs[p] = x; ys[p] = y; zs[p] = z; ++p;
+                        const FloatT qx = x, qy = y, qz = z;
+                        x = a[0] * qx + a[1] * qy + a[2] * qz;
+                        y = a[3] * qx + a[4] * qy + a[5] * qz;
+                        z = a[6] * qx + a[7] * qy + a[8] * qz;
+                    } break;
+
+                    case OP_POP:
+                        --p; x = xs[p]; y = ys[p]; z = zs[p];
+                        top *= a[0];
+                        break;
+                }
+            }
+
+            return top;
+        }
+    };
+
+    // Turns the text format into a SceneBuffer
+    class SceneParser {
+    private: // Variables
+        struct Token {
+            std::string text;
+            int line;
+        };
+
+        std::string _name;
+        std::vector<Token> _tokens;
+        std::size_t _next = 0;
+
+        SceneHeader _header;
+        std::vector<SceneLight> _lights;
+        std::vector<SceneNode> _nodes;
+
+        // Shapes currently being parsed, guards the recursion
+        int _nesting = 0;
+
+    public: // Constructor
+        SceneParser(const char* text, std::size_t size, const std::string& name) : _name{name} {
+            int line = 1;
+            for(std::size_t i = 0; i < size;) {
+                if(text[i] == '\n') ++line;
+
+                if(text[i] == '#') {
+                    while(i < size && text[i] != '\n') ++i;
+                } else if(std::isspace(static_cast<unsigned char>(text[i]))) {
+                    ++i;
+                } else {
+                    const std::size_t start = i;
+                    while(i < size && !std::isspace(static_cast<unsigned char>(text[i])) && text[i] != '#') ++i;
+                    _tokens.push_back(Token{std::string(text + start, i - start), line});
+                }
+            }
+
+            std::memset(&_header, 0, sizeof(_header));
+            std::memcpy(_header.magic, SCENE_MAGIC, 4);
+            _header.version = SCENE_VERSION;
+
+            const Vec3d pos = Vec3d(1, 1, 1);
+            _header.camera[0] = pos.x; _header.camera[1] = pos.y; _header.camera[2] = pos.z;
+            _header.camera[3] = 90;
+
+            _header.material[0] = DEFAULT_MATERIAL.k_s; _header.material[1] = DEFAULT_MATERIAL.k_d;
+            _header.material[2] = DEFAULT_MATERIAL.k_a; _header.material[3] = DEFAULT_MATERIAL.a;
+        }
+
+    public: // Functions
+        bool parse(SceneBuffer& out) {
+            bool has_sdf = false;
+            std::string word;
+            while(_next < _tokens.size()) {
+                if(!keyword(word)) return false;
+
+                if(word == "camera") {
+                    if(!numbers(_header.camera, 4)) return false;
+                } else if(word == "material") {
+                    if(!numbers(_header.material, 4)) return false;
+                } else if(word == "light") {
+                    SceneLight l;
+                    if(!numbers(l.pos, 3) || !numbers(l.color, 3) || !numbers(&l.brightness, 1)) return false;
+                    _lights.push_back(l);
+                } else if(word == "sdf") {
+                    if(has_sdf) return error("scene has more than one sdf");
+                    if(!shape(1, 0)) return false;
+                    has_sdf = true;
+                } else {
+                    return error("unknown statement '" + word + "'");
+                }
+            }
+
+            if(!has_sdf) return error("scene has no sdf");
+
+            _header.lights = _lights.size();
+            _header.nodes = _nodes.size();
+
+            const std::size_t size = sizeof(SceneHeader) + _lights.size() * sizeof(SceneLight) + _nodes.size() * sizeof(SceneNode);
+            std::shared_ptr<char> data(new char[size], std::default_delete<char[]>());
+            char* at = data.get();
+            std::memcpy(at, &_header, sizeof(SceneHeader));                     at += sizeof(SceneHeader);
+            std::memcpy(at, _lights.data(), _lights.size() * sizeof(SceneLight)); at += _lights.size() * sizeof(SceneLight);
+            std::memcpy(at, _nodes.data(), _nodes.size() * sizeof(SceneNode));
+
+            out = SceneBuffer(data, size);
+            return out.validate() || error("scene nests too deeply");
+        }
+
+    private: // Helper Functions
+        bool error(const std::string& message) {
+            const int line = _tokens.empty() ? 0 : _tokens[std::min(_next, _tokens.size() - 1)].line;
+            std::fprintf(stderr, "%s:%d: %s\n", _name.c_str(), line, message.c_str());
+            return false;
+        }
+
+        bool keyword(std::string& word) {
+            if(_tokens.size() <= _next) return error("unexpected end of file");
+            word = _tokens[_next++].text;
+            return true;
+        }
+
+        bool numbers(FloatT* out, int count) {
+            for(int i = 0; i < count; ++i) {
+                if(_tokens.size() <= _next) return error("expected a number");
+
+                const std::string& text = _tokens[_next].text;
+                char* end = nullptr;
+                out[i] = std::strtod(text.c_str(), &end);
+                if(end != text.c_str() + text.size()) return error("expected a number, got '" + text + "'");
+                ++_next;
+            }
+            return true;
+        }
+
+        void emit(std::uint32_t op, std::initializer_list<FloatT> args = {}) {
+            SceneNode n;
+            std::memset(&n, 0, sizeof(n));
+            n.op = op;
+            std::copy(args.begin(), args.end(), n.args);
+            _nodes.push_back(n);
+        }
+
+        // Push the point transform, parse the shape it applies to, then pop it
+        bool transformed(const Mat3d& mat, FloatT factor, int points, int values) {
+            emit(OP_LINEAR, {
+                mat[0][0], mat[0][1], mat[0][2],
+                mat[1][0], mat[1][1], mat[1][2],
+                mat[2][0], mat[2][1], mat[2][2]
+            });
+            if(!shape(points + 1, values)) return false;
+            emit(OP_POP, { factor });
+            return true;
+        }
+
+        // Same as Mat3d * SDF, but scaled by the bound right away so every node stays a true distance
+        bool rotated(const Mat3d& lhs, int points, int values) {
+            const Mat3d mat = lhs.inv();
+            return transformed(mat, FloatT(1) / mat.norm(), points, values);
+        }
+
+        // points and values are the stack depths before this shape runs
+        bool shape(int points, int values) {
+            if(SCENE_STACK_DEPTH <= points || SCENE_STACK_DEPTH <= values || SCENE_MAX_NESTING <= _nesting) {
+                return error("scene nests too deeply");
+            }
+
+            ++_nesting;
+            const bool ok = parseShape(points, values);
+            --_nesting;
+            return ok;
+        }
+
+        bool parseShape(int points, int values) {
+            const FloatT DEG = FloatT(SPGL::Math::Pi) / FloatT(180);
+            FloatT a[9];
+            std::string word;
+            if(!keyword(word)) return false;
+
+            if(word == "sphere") {
+                if(!numbers(a, 1)) return false;
+                emit(OP_SPHERE, { a[0] });
+            } else if(word == "box") {
+                if(!numbers(a, 3)) return false;
+                emit(OP_BOX, { a[0], a[1], a[2] });
+            } else if(word == "plane") {
+                if(!numbers(a, 4)) return false;
+                const Vec3d n = Vec3d(a[0], a[1], a[2]).norm();
+                emit(OP_PLANE, { n.x, n.y, n.z, a[3] });
+            } else if(word == "cylinder") {
+                if(!numbers(a, 1)) return false;
+                emit(OP_CYLINDER, { a[0] });
+            } else if(word == "squilindar") {
+                if(!numbers(a, 1)) return false;
+                emit(OP_SQUILINDAR, { a[0] });
+            } else if(word == "squircle") {
+                if(!numbers(a, 1)) return false;
+                emit(OP_SQUIRCLE, { a[0] });
+            } else if(word == "invert") {
+                if(!shape(points, values)) return false;
+                emit(OP_INVERT);
+            } else if(word == "inflate") {
+                if(!numbers(a, 1) || !shape(points, values)) return false;
+                emit(OP_INFLATE, { a[0] });
+            } else if(word == "union" || word == "intersect") {
+                if(!numbers(a, 1)) return false;
+                const int count = int(a[0]);
+                if(count < 1 || FloatT(count) != a[0]) return error("expected a shape count");
+
+                // Fold as we go so wide unions do not grow the stack
+                if(!shape(points, values)) return false;
+                for(int i = 1; i < count; ++i) {
+                    if(!shape(points, values + 1)) return false;
+                    emit(word == "union" ? OP_UNION : OP_INTERSECT);
+                }
+            } else if(word == "subtract") {
+                if(!shape(points, values) || !shape(points, values + 1)) return false;
+                emit(OP_SUBTRACT);
+            } else if(word == "translate") {
+                if(!numbers(a, 3)) return false;
+                if(a[0] == 0 && a[1] == 0 && a[2] == 0) return shape(points, values);
+
+                const std::size_t start = _nodes.size();
+                emit(OP_TRANSLATE, { a[0], a[1], a[2] });
+                if(!shape(points + 1, values)) return false;
+
+                // A lone primitive can be moved itself, saving the push and pop
+                if(_nodes.size() == start + 2 && _nodes.back().op <= OP_SQUIRCLE) {
+                    SceneNode leaf = _nodes.back();
+                    leaf.args[6] += a[0]; leaf.args[7] += a[1]; leaf.args[8] += a[2];
+                    _nodes.resize(start);
+                    _nodes.push_back(leaf);
+                } else {
+                    emit(OP_POP, { 1 });
+                }
+            } else if(word == "scale") {
+                if(!numbers(a, 1)) return false;
+                return transformed(Mat3d::Identity() / a[0], a[0], points, values);
+            } else if(word == "stretch") {
+                if(!numbers(a, 3)) return false;
+                const Mat3d mat = Mat3d({ 1 / a[0], 0, 0 }, { 0, 1 / a[1], 0 }, { 0, 0, 1 / a[2] });
+                return transformed(mat, std::min(a[0], std::min(a[1], a[2])), points, values);
+            } else if(word == "roll") {
+                if(!numbers(a, 1)) return false;
+                return rotated(Mat3d::Roll(a[0] * DEG), points, values);
+            } else if(word == "pitch") {
+                if(!numbers(a, 1)) return false;
+                return rotated(Mat3d::Pitch(a[0] * DEG), points, values);
+            } else if(word == "yaw") {
+                if(!numbers(a, 1)) return false;
+                return rotated(Mat3d::Yaw(a[0] * DEG), points, values);
+            } else if(word == "matrix") {
+                if(!numbers(a, 9)) return false;
+                return rotated(Mat3d({ a[0], a[1], a[2] }, { a[3], a[4], a[5] }, { a[6], a[7], a[8] }), points, values);
+            } else {
+                --_next;
+                return error("unknown shape '" + word + "'");
+            }
+
+            return true;
+        }
+    };
+
+    inline bool parseScene(const char* text, std::size_t size, const std::string& name, SceneBuffer& out) {
+        return SceneParser(text, size, name).parse(out);
+    }
+
+    // Load a text or binary scene. Binary scenes are mapped, not copied.
+    inline bool loadScene(const std::string& path, SceneBuffer& out) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if(fd < 0 || ::fstat(fd, &info) != 0 || info.st_size == 0) {
+            if(0 <= fd) ::close(fd);
+            std::fprintf(stderr, "Unable to read scene %s\n", path.c_str());
+            return false;
+        }
+
+        const std::size_t size = info.st_size;
+        void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(map == MAP_FAILED) {
+            std::fprintf(stderr, "Unable to map scene %s\n", path.c_str());
+            return false;
+        }
+
+        const std::shared_ptr<const char> data(static_cast<const char*>(map), [size](const char* p) {
+            ::munmap(const_cast<char*>(p), size);
+        });
+
+        if(sizeof(SceneHeader) <= size && std::memcmp(data.get(), SCENE_MAGIC, 4) == 0) {
+            out = SceneBuffer(data, size);
+            if(out.validate()) return true;
+
+            std::fprintf(stderr, "%s is not a valid binary scene\n", path.c_str());
+            return false;
+        }
+
+        return parseScene(data.get(), size, path, out);
+    }
+
+    inline bool saveScene(const SceneBuffer& scene, const std::string& path) {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if(file == nullptr) return false;
+
+        const bool ok = std::fwrite(scene.data(), 1, scene.size(), file) == scene.size();
+        return (std::fclose(file) == 0) && ok;
+    }
+
+    // Replace the SDF, lights, material and camera of a scene with a validated buffer
+    inline void buildScene(const SceneBuffer& buffer, Scene& scene) {
+        const SceneHeader& h = buffer.header();
+
+        const auto program = std::make_shared<const SceneProgram>(buffer);
+        scene.scene = SDF([program](const Vec3d& pos) {
+            return (*program)(pos);
+        });
+
+        scene.lights.clear();
+        for(std::uint32_t i = 0; i < h.lights; ++i) {
+            const SceneLight& l = buffer.lights()[i];
+            scene.lights.push_back(Light(
+                Vec3d(l.pos[0], l.pos[1], l.pos[2]),
+                SPGL::Color(
+                    int(std::clamp(l.color[0], FloatT(0), FloatT(255))),
+                    int(std::clamp(l.color[1], FloatT(0), FloatT(255))),
+                    int(std::clamp(l.color[2], FloatT(0), FloatT(255)))
+                ),
+                l.brightness
+            ));
+        }
+
+        if(scene.shadows) scene.shadows->clear();
+
+        scene.material = Material(h.material[0], h.material[1], h.material[2], h.material[3]);
+
+        scene.camera.setFov(h.camera[3]);
+        scene.camera.setPos(Vec3d(h.camera[0], h.camera[1], h.camera[2]));
+    }
+
+}
+
+#endif
@@ -7,16 +7,28 @@
 #include "camera.hpp"
 #include "scene.hpp"
 #include "mat3.hpp"
-
-#include <thread>
+#include "governor.hpp"
+#include "progressive.hpp"
+#include "checkerboard.hpp"
+#include "parallel.hpp"
+#include "batch.hpp"
+#include "distributed.hpp"
+#include "loader.hpp"
+#include "trace.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <utility>
+#include <vector>
 
 using namespace sb;
 
 
-int main() {
-    std::thread threads[THREADS];
-
-    SPGL::Window<> window(WIDTH, HEIGHT, "Sam Marcher");
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
 
     const FloatT PI = SPGL::Math::Pi;
 
@@ -36,30 +48,155 @@ int main() {
     };
 
     Scene scene(sdf, lights, SPGL::Image(WIDTH, HEIGHT));
+    scene.camera.setPos(Vec3d(20*std::cos(1.5), 10, 20*std::sin(1.5)));
+
+    // marcher --scene <file> [mode]
+    SceneBuffer source;
+    if(2 <= args.size() && args[0] == "--scene") {
+        if(!loadScene(args[1], source)) return 1;
+        buildScene(source, scene);
+        args.erase(args.begin(), args.begin() + 2);
+    }
 
-
-    FloatT t = 1.5;
-    while(window.isRunning()) {
-        t += 0.1;
-        scene.camera.setFov(90);
-        scene.camera.setPos(Vec3d(20*std::cos(t), 10, 20*std::sin(t)));
-
-        for(int g = 0; g < THREADS; ++g) {
-            threads[g] = std::thread([=,&scene]() {
-                int gaps = PIXELS / THREADS;
-                for(int i = gaps * g; i < std::min(gaps * (g + 1), PIXELS); ++i) {
-                    scene.updatePixel(i);
-                }
-            });
+    // marcher --scene <file> --compile <out>
+    if(args.size() == 2 && args[0] == "--compile") {
+        if(source.empty() || !saveScene(source, args[1])) {
+            std::fprintf(stderr, "Unable to compile scene to %s\n", args[1].c_str());
+            return 1;
         }
-        for(auto& t : threads) {
-            t.join();
+        return 0;
+    }
+
+    // marcher --check-lipschitz [samples]
+    if(1 <= args.size() && args[0] == "--check-lipschitz") {
+        const int samples = 2 <= args.size() ? std::atoi(args[1].c_str()) : 1000000;
+        const FloatT worst = scene.scene.checkLipschitz(Vec3d(0, 0, 0), MAX_DISTANCE / 4, samples);
+
+        std::printf("Lipschitz bound %.4f, worst sampled rate %.4f of the bound\n", scene.scene.lipschitz(), worst);
+        return worst <= FloatT(1.001) ? 0 : 1;
+    }
+
+    // Every mode below renders
+    if(SHADOW_CACHE) scene.shadows = std::make_shared<ShadowCache>();
+
+    // Orbit around the y axis, starting from where the scene put the camera
+    const Vec3d origin = scene.camera.pos();
+    const FloatT radius = std::hypot(origin.x, origin.z);
+    const FloatT angle = std::atan2(origin.z, origin.x);
+    const auto orbit = [=](Camera& camera, FloatT t) {
+        camera.setPos(Vec3d(radius*std::cos(angle + t), origin.y, radius*std::sin(angle + t)));
+    };
+
+    // marcher --batch <frames> <prefix>
+    if(args.size() == 3 && args[0] == "--batch") {
+        const int frames = std::atoi(args[1].c_str());
+        const auto start = std::chrono::steady_clock::now();
+
+        const bool ok = renderAnimation(scene, frames, [&](int frame, Camera& camera) {
+            orbit(camera, ORBIT_SPEED * (frame + 1));
+        }, args[2]);
+
+        const std::chrono::duration<FloatT> seconds = std::chrono::steady_clock::now() - start;
+        std::printf("Rendered %d frames in %.2fs (%.2f fps)\n", frames, seconds.count(), frames / seconds.count());
+        if(scene.shadows) {
+            const std::size_t total = scene.shadows->hits() + scene.shadows->misses();
+            std::printf("Shadow cache hit %.1f%% of %zu lookups\n", total ? 100.0 * scene.shadows->hits() / total : 0.0, total);
         }
+        SB_TRACE_FLUSH(TRACE_FILE);
+        return ok ? 0 : 1;
+    }
+
+    // marcher --coordinate <address> <out.ppm> [local workers] [width height]
+    if(3 <= args.size() && args[0] == "--coordinate") {
+        const int local = 4 <= args.size() ? std::atoi(args[3].c_str()) : 0;
+        const int width = 6 <= args.size() ? std::atoi(args[4].c_str()) : WIDTH;
+        const int height = 6 <= args.size() ? std::atoi(args[5].c_str()) : HEIGHT;
+
+        Scene still(scene.scene, scene.lights, SPGL::Image(width, height), scene.material);
+        still.shadows = scene.shadows;
+        still.camera.setFov(scene.camera.fov());
+        orbit(still.camera, ORBIT_SPEED);
+
+        const bool ok = coordinate(still, args[1], local, source);
+        SB_TRACE_FLUSH(TRACE_FILE);
+        if(!ok) return 1;
+        return writePPM(still.image, args[2]) ? 0 : 1;
+    }
+
+    // marcher --work <address>
+    if(args.size() == 2 && args[0] == "--work") {
+        const bool ok = work(scene, args[1], source);
+        SB_TRACE_FLUSH(TRACE_FILE);
+        return ok ? 0 : 1;
+    }
+
+    SPGL::Window<> window(WIDTH, HEIGHT, "Sam Marcher");
+
+    Governor governor;
+    Progressive progressive(WIDTH, HEIGHT);
+    Checkerboard checkerboard(WIDTH, HEIGHT);
 
-        window.renderImage(scene.image);
-        window.update();
+    // Frame on screen while the next one renders into scene.image
+    SPGL::Image front(WIDTH, HEIGHT);
 
+    FloatT t = 0;
+    while(window.isRunning()) {
+        const Vec3d last_pos = scene.camera.pos();
+
+        t += ORBIT_SPEED;
+        orbit(scene.camera, t);
+
+        const bool moving = (scene.camera.pos() - last_pos).mag() > EPS;
+
+        // Workers render the next frame while this thread presents the last one
+        std::future<bool> frame = std::async(std::launch::async, [&]() {
+            SB_TRACE_THREAD(THREADS + 1);
+            SB_TRACE_SPAN("frame");
+            const auto start = std::chrono::steady_clock::now();
+
+            // Fraction of the pixels marched, 0 when it is not a full frame
+            FloatT coverage = 0;
+
+            if(moving && CHECKERBOARD && governor.stride() == 1) {
+                checkerboard.step(scene);
+                coverage = checkerboard.coverage();
+                progressive.reset();
+            } else if(moving) {
+                const int stride = governor.stride();
+                parallelFor(scene.blocks(stride), [&](int i) {
+                    scene.updateBlock(i, stride);
+                });
+                coverage = FloatT(1) / FloatT(stride * stride);
+                progressive.reset();
+                checkerboard.reset();
+            } else if(!progressive.done()) {
+                progressive.step(scene);
+                checkerboard.reset();
+            } else {
+                return false;
+            }
+
+            const std::chrono::duration<FloatT, std::milli> frame_ms = std::chrono::steady_clock::now() - start;
+            // Progressive passes march an uneven share of the pixels, so they
+            // are left out of the cost estimate
+            if(0 < coverage) governor.measure(frame_ms.count(), coverage);
+            governor.update(moving);
+            return true;
+        });
+
+        {
+            SB_TRACE_SPAN("present");
+            window.renderImage(front);
+            window.update();
+        }
+
+        SB_TRACE_SPAN("wait");
+        if(frame.get()) {
+            std::swap(front, scene.image);
+        }
     }
 
+    SB_TRACE_FLUSH(TRACE_FILE);
+
 
-}
\ No newline at end of file
+}
@@ -3,6 +3,7 @@
 
 #include "vec3.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <array>
 
@@ -113,6 +114,33 @@ namespace sb {
             return adj() /= det();
         }
 
+        constexpr Mat3 transpose() const {
+            return Mat3(
+                {_data[0][0], _data[1][0], _data[2][0]},
+                {_data[0][1], _data[1][1], _data[2][1]},
+                {_data[0][2], _data[1][2], _data[2][2]}
+            );
+        }
+
+        // Largest factor the matrix can stretch a vector by (the spectral norm).
+        // This is the square root of the largest eigenvalue of A^T * A, which
+        // is symmetric, so its eigenvalues have a closed form.
+        T norm() const {
+            const Mat3 a = transpose() * (*this);
+
+            const T p1 = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+            const T q = (a[0][0] + a[1][1] + a[2][2]) / T(3);
+            const T p2 = (a[0][0] - q) * (a[0][0] - q) + (a[1][1] - q) * (a[1][1] - q) + (a[2][2] - q) * (a[2][2] - q) + T(2) * p1;
+            const T p = std::sqrt(p2 / T(6));
+
+            // A multiple of the identity
+            if(p == T(0)) return std::sqrt(q);
+
+            const Mat3 b = (a + Mat3::Identity() * -q) / p;
+            const T r = std::max(T(-1), std::min(T(1), b.det() / T(2)));
+            return std::sqrt(q + T(2) * p * std::cos(std::acos(r) / T(3)));
+        }
+
         constexpr friend Mat3 operator+(Mat3 lhs, const Mat3& rhs) { return lhs += rhs; }
         constexpr Mat3& operator+=(const Mat3& rhs) {
             _data[0][0] += rhs[0][0]; _data[0][1] += rhs[0][1]; _data[0][2] += rhs[0][2];
@@ -0,0 +1,171 @@
+#ifndef SAM_B_NET_HPP
+#define SAM_B_NET_HPP 1
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace sb {
+
+    // Small RAII wrapper around a POSIX stream socket. Addresses are either
+    // "unix:/path/to/socket" or "host:port" for TCP.
+    class Socket {
+    private: // Variables
+        int _fd;
+
+    public: // Static Constructors
+        static Socket listen(const std::string& address) {
+            if(address.rfind("unix:", 0) == 0) {
+                sockaddr_un addr = unixAddress(address.substr(5));
+                ::unlink(addr.sun_path);
+
+                Socket s(::socket(AF_UNIX, SOCK_STREAM, 0));
+                if(!s.valid()
+                    || ::bind(s._fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+                    || ::listen(s._fd, SOMAXCONN) != 0) return Socket();
+                return s;
+            }
+
+            addrinfo* info = resolve(address, true);
+            for(addrinfo* i = info; i != nullptr; i = i->ai_next) {
+                Socket s(::socket(i->ai_family, i->ai_socktype, i->ai_protocol));
+                if(!s.valid()) continue;
+
+                const int yes = 1;
+                ::setsockopt(s._fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+                if(::bind(s._fd, i->ai_addr, i->ai_addrlen) == 0 && ::listen(s._fd, SOMAXCONN) == 0) {
+                    ::freeaddrinfo(info);
+                    return s;
+                }
+            }
+
+            if(info != nullptr) ::freeaddrinfo(info);
+            return Socket();
+        }
+
+        static Socket connect(const std::string& address) {
+            if(address.rfind("unix:", 0) == 0) {
+                sockaddr_un addr = unixAddress(address.substr(5));
+
+                Socket s(::socket(AF_UNIX, SOCK_STREAM, 0));
+                if(!s.valid() || ::connect(s._fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) return Socket();
+                return s;
+            }
+
+            addrinfo* info = resolve(address, false);
+            for(addrinfo* i = info; i != nullptr; i = i->ai_next) {
+                Socket s(::socket(i->ai_family, i->ai_socktype, i->ai_protocol));
+                if(!s.valid()) continue;
+
+                if(::connect(s._fd, i->ai_addr, i->ai_addrlen) == 0) {
+                    // Tiles are small request / response pairs, do not wait to batch them
+                    const int yes = 1;
+                    ::setsockopt(s._fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                    ::freeaddrinfo(info);
+                    return s;
+                }
+            }
+
+            if(info != nullptr) ::freeaddrinfo(info);
+            return Socket();
+        }
+
+    public: // Constructors
+        explicit Socket(int fd = -1) : _fd{fd} {}
+
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+
+        Socket(Socket&& other) noexcept : _fd{std::exchange(other._fd, -1)} {}
+        Socket& operator=(Socket&& other) noexcept {
+            std::swap(_fd, other._fd);
+            return *this;
+        }
+
+        ~Socket() {
+            if(valid()) ::close(_fd);
+        }
+
+    public: // Getters
+        int fd() const {
+            return _fd;
+        }
+
+        bool valid() const {
+            return 0 <= _fd;
+        }
+
+    public: // Functions
+        Socket accept() const {
+            return Socket(::accept(_fd, nullptr, nullptr));
+        }
+
+        // Make sendAll() and recvAll() fail if the peer stalls for this long
+        bool setTimeout(int seconds) const {
+            timeval tv;
+            tv.tv_sec = seconds;
+            tv.tv_usec = 0;
+            return ::setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0
+                && ::setsockopt(_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == 0;
+        }
+
+        bool sendAll(const void* data, std::size_t size) const {
+            const char* bytes = static_cast<const char*>(data);
+            while(0 < size) {
+                const ssize_t sent = ::send(_fd, bytes, size, 0);
+                if(sent <= 0) return false;
+                bytes += sent;
+                size -= sent;
+            }
+            return true;
+        }
+
+        bool recvAll(void* data, std::size_t size) const {
+            char* bytes = static_cast<char*>(data);
+            while(0 < size) {
+                const ssize_t got = ::recv(_fd, bytes, size, 0);
+                if(got <= 0) return false;
+                bytes += got;
+                size -= got;
+            }
+            return true;
+        }
+
+    private: // Helper Functions
+        static sockaddr_un unixAddress(const std::string& path) {
+            sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+            return addr;
+        }
+
+        static addrinfo* resolve(const std::string& address, bool passive) {
+            const std::size_t colon = address.rfind(':');
+            const std::string host = colon == std::string::npos ? "" : address.substr(0, colon);
+            const std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+
+            addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+            addrinfo* info = nullptr;
+            if(::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info) != 0) return nullptr;
+            return info;
+        }
+    };
+
+}
+
+#endif
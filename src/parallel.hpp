@@ -0,0 +1,35 @@
+#ifndef SAM_B_PARALLEL_HPP
+#define SAM_B_PARALLEL_HPP 1
+
+#include <algorithm>
+#include <thread>
+
+#include "constants.hpp"
+#include "trace.hpp"
+
+namespace sb {
+
+    // Split [0, count) into THREADS contiguous ranges and run func(i) on each
+    template<typename Func>
+    void parallelFor(const int count, const Func& func) {
+        std::thread threads[THREADS];
+
+        const int gaps = (count + THREADS - 1) / THREADS;
+        for(int g = 0; g < THREADS; ++g) {
+            threads[g] = std::thread([=,&func]() {
+                SB_TRACE_THREAD(g + 1);
+                SB_TRACE_SPAN("tile", gaps * g);
+                for(int i = gaps * g; i < std::min(gaps * (g + 1), count); ++i) {
+                    func(i);
+                }
+            });
+        }
+
+        for(auto& t : threads) {
+            t.join();
+        }
+    }
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef SAM_B_PROGRESSIVE_HPP
+#define SAM_B_PROGRESSIVE_HPP 1
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "SPGL/SPGL/SPGL.hpp"
+#include "constants.hpp"
+#include "color.hpp"
+#include "parallel.hpp"
+#include "scene.hpp"
+
+namespace sb {
+
+    // Renders a still frame over several calls to step(). The first pass
+    // marches a coarse grid, each following pass halves the grid spacing but
+    // only marches where the surrounding samples disagree, and the last
+    // passes add extra samples to pixels that sit on an edge.
+    class Progressive {
+    private: // Variables
+        SPGL::Size _width, _height;
+
+        // HDR accumulation of every sample a pixel has received
+        std::vector<Vec3d> _sum;
+        std::vector<int> _count;
+
+        // First sample of every pixel, used to decide where to refine
+        std::vector<Sample> _base;
+        std::vector<char> _edge;
+
+        // Grid spacing of the last pass, 0 before the coarse pass
+        int _stride;
+        int _samples;
+
+    public: // Constructor
+        Progressive(SPGL::Size width, SPGL::Size height)
+            : _width{width}, _height{height}
+            , _sum(width * height), _count(width * height)
+            , _base(width * height), _edge(width * height) {
+            reset();
+        }
+
+    public: // Functions
+        // Throw away the accumulated image, call this when the camera moves
+        void reset() {
+            _stride = 0;
+            _samples = 1;
+        }
+
+        bool done() const {
+            return _stride == 1 && PROGRESSIVE_SAMPLES <= _samples;
+        }
+
+        // Run the next pass and write the current estimate into scene.image
+        void step(Scene& scene) {
+            if(_stride == 0) {
+                coarse(scene);
+                _stride = PROGRESSIVE_STRIDE;
+            } else if(1 < _stride) {
+                _stride /= 2;
+                refine(scene, _stride);
+                if(_stride == 1) findEdges();
+            } else if(_samples < PROGRESSIVE_SAMPLES) {
+                supersample(scene);
+                ++_samples;
+            }
+
+            resolve(scene.image);
+        }
+
+    private: // Helper Functions
+        SPGL::Size index(SPGL::Size x, SPGL::Size y) const {
+            return y * _width + x;
+        }
+
+        void put(SPGL::Size x, SPGL::Size y, const Sample& sample) {
+            const SPGL::Size i = index(x, y);
+            _base[i] = sample;
+            _sum[i] = sample.radiance;
+            _count[i] = 1;
+        }
+
+        static bool similar(const Sample& a, const Sample& b) {
+            return a.hit == b.hit
+                && std::abs(a.steps - b.steps) <= REFINE_STEP_DIFF
+                && colorDiff(a.color, b.color) <= REFINE_COLOR_DIFF
+                && std::abs(a.distance - b.distance) <= REFINE_DISTANCE_RATIO * std::min(a.distance, b.distance);
+        }
+
+        static Sample blend(const Sample& a, const Sample& b) {
+            return Sample{
+                toColor((a.radiance + b.radiance) / FloatT(2)),
+                (a.radiance + b.radiance) / FloatT(2),
+                (a.distance + b.distance) / FloatT(2),
+                (a.steps + b.steps) / 2,
+                a.hit
+            };
+        }
+
+        void coarse(const Scene& scene) {
+            const SPGL::Size columns = (_width + PROGRESSIVE_STRIDE - 1) / PROGRESSIVE_STRIDE;
+            const SPGL::Size rows = (_height + PROGRESSIVE_STRIDE - 1) / PROGRESSIVE_STRIDE;
+
+            parallelFor(columns * rows, [&](int i) {
+                const SPGL::Size x = (i % columns) * PROGRESSIVE_STRIDE;
+                const SPGL::Size y = (i / columns) * PROGRESSIVE_STRIDE;
+                put(x, y, scene.getSample(x, y));
+            });
+        }
+
+        // Fill in the points at spacing s that lie between the points at spacing 2s
+        void refine(const Scene& scene, const SPGL::Size s) {
+            const SPGL::Size big = 2 * s;
+            const SPGL::Size columns = (_width + big - 1) / big;
+            const SPGL::Size rows = (_height + big - 1) / big;
+
+            parallelFor(columns * rows, [&](int i) {
+                const SPGL::Size x = (i % columns) * big;
+                const SPGL::Size y = (i / columns) * big;
+
+                // Blocks along the bottom and right edge have no far corners
+                bool smooth = x + big < _width && y + big < _height;
+                if(smooth) {
+                    const Sample& a = _base[index(x, y)];
+                    const Sample& b = _base[index(x + big, y)];
+                    const Sample& c = _base[index(x, y + big)];
+                    const Sample& d = _base[index(x + big, y + big)];
+                    smooth = similar(a, b) && similar(a, c) && similar(b, d) && similar(c, d);
+
+                    if(smooth) {
+                        put(x + s, y, blend(a, b));
+                        put(x, y + s, blend(a, c));
+                        put(x + s, y + s, blend(blend(a, d), blend(b, c)));
+                        return;
+                    }
+                }
+
+                if(x + s < _width)                     put(x + s, y, scene.getSample(x + s, y));
+                if(y + s < _height)                    put(x, y + s, scene.getSample(x, y + s));
+                if(x + s < _width && y + s < _height)  put(x + s, y + s, scene.getSample(x + s, y + s));
+            });
+        }
+
+        void findEdges() {
+            parallelFor(_height, [&](int y) {
+                for(SPGL::Size x = 0; x < _width; ++x) {
+                    const Sample& s = _base[index(x, y)];
+                    _edge[index(x, y)] = 
+                           (0 < x && !similar(s, _base[index(x - 1, y)]))
+                        || (0 < y && !similar(s, _base[index(x, y - 1)]))
+                        || (x + 1 < _width && !similar(s, _base[index(x + 1, y)]))
+                        || (SPGL::Size(y) + 1 < _height && !similar(s, _base[index(x, y + 1)]));
+                }
+            });
+        }
+
+        void supersample(const Scene& scene) {
+            // R2 low discrepancy sequence, so every pass lands somewhere new in the pixel
+            const FloatT ox = std::fmod(FloatT(0.5) + _samples * FloatT(0.7548776662466927), FloatT(1));
+            const FloatT oy = std::fmod(FloatT(0.5) + _samples * FloatT(0.5698402909980532), FloatT(1));
+
+            parallelFor(_height, [&](int y) {
+                for(SPGL::Size x = 0; x < _width; ++x) {
+                    const SPGL::Size i = index(x, y);
+                    if(_edge[i]) {
+                        _sum[i] += scene.getSample(x + ox, y + oy).radiance;
+                        _count[i] += 1;
+                    }
+                }
+            });
+        }
+
+        // Show every pixel as the nearest point rendered at the current spacing
+        void resolve(SPGL::Image& image) const {
+            const SPGL::Size s = _stride;
+            parallelFor(_height, [&](int y) {
+                for(SPGL::Size x = 0; x < _width; ++x) {
+                    const SPGL::Size i = index(x - x % s, y - y % s);
+                    image(x, y) = toColor(_sum[i] / FloatT(_count[i]));
+                }
+            });
+        }
+    };
+
+}
+
+#endif
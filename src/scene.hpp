@@ -3,29 +3,56 @@
 
 #include "SPGL/SPGL/SPGL.hpp"
 #include "camera.hpp"
+#include "color.hpp"
 #include "light.hpp"
 #include "sdf.hpp"
+#include "shadows.hpp"
+#include "trace.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 namespace sb {
 
+    // Result of marching a single primary ray
+    struct Sample {
+        // Always toColor(radiance), so marched and averaged pixels match
+        SPGL::Color color;
+
+        // Unclamped color in the 0-255 scale, for averaging samples
+        Vec3d radiance;
+
+        // Distance travelled before the first hit (MAX_DISTANCE on a miss)
+        FloatT distance;
+
+        // Number of marching steps the primary ray took, a grazing miss takes many
+        int steps;
+
+        bool hit;
+    };
+
     class Scene {
     public: // Variables
         SDF scene;
         std::vector<Light> lights;
         SPGL::Image image;
         Camera camera;
+        Material material;
+
+        // Shared between copies of the scene, nullptr marches every shadow ray
+        std::shared_ptr<ShadowCache> shadows;
     
     public: // Constructor
-        Scene(const SDF& scene, const std::vector<Light>& lights, const SPGL::Image& image) 
-            : scene{scene}, lights{lights}, image{image}, camera{Camera(image.width(), image.height())} {}
+        Scene(const SDF& scene, const std::vector<Light>& lights, const SPGL::Image& image, const Material& material = DEFAULT_MATERIAL) 
+            : scene{scene}, lights{lights}, image{image}, camera{Camera(image.width(), image.height())}, material{material} {}
 
     private: // Helper Functions
-        SPGL::Color march(Ray ray, std::size_t hits, const Material& mat = DEFAULT_MATERIAL) const {
+        Sample march(Ray ray, std::size_t hits, const Material& mat = DEFAULT_MATERIAL) const {
             
             double distance = 0.0;
-            for(int i = 0; i < MAX_MARCH_ITER; ++i) {
+            int i = 0;
+            for(; i < MAX_MARCH_ITER; ++i) {
                 double step = scene(ray.pos());
                 distance += step;
                 
@@ -34,28 +61,44 @@ namespace sb {
                 }
 
                 if(step < EPS) {
-                    SPGL::Color out = SPGL::Color::Black;
+                    Vec3d radiance;
                     const FloatT f = fresnel(mat.k_s, scene.normal(ray.pos()), -ray.dir());
 
-                    for(const auto& l : lights) 
-                        out += l.getColor(scene, ray, mat);
+                    for(std::size_t l = 0; l < lights.size(); ++l) {
+                        bool direct;
+                        {
+                            SB_TRACE_RAY("shadow", l);
+                            direct = shadows 
+                                ? shadows->visible(l, ray.pos(), [&]() { return lights[l].getDirectLight(scene, ray.pos()); })
+                                : lights[l].getDirectLight(scene, ray.pos());
+                        }
+
+                        radiance += lights[l].getIntensity(scene, ray, mat, direct) * toVec(lights[l].color());
+                    }
                     
                     if(0 < hits) {
-                        out += march(ray.reflect(scene, i * FIXING_RATIO * EPS), hits - 1) * f;
+                        SB_TRACE_RAY("reflection", hits);
+                        const Sample bounce = march(ray.reflect(scene, i * FIXING_RATIO * EPS), hits - 1, mat);
+                        radiance += bounce.radiance * f;
                     }
 
-                    return out; 
+                    return Sample{toColor(radiance), radiance, distance, i, true}; 
                 }
 
                 ray = ray.step(step);
             }
 
-            return AMBIENT_COLOR;
+            return Sample{AMBIENT_COLOR, toVec(AMBIENT_COLOR), MAX_DISTANCE, i, false};
         }
 
     public: // Functions
+        Sample getSample(FloatT x, FloatT y) const {
+            SB_TRACE_RAY("primary");
+            return march(Ray(camera(x, y)), MAX_HITS, material);
+        }
+
         SPGL::Color getPixel(SPGL::Size x, SPGL::Size y) const {
-            return march(Ray(camera(x, y)), MAX_HITS);
+            return getSample(x, y).color;
         }
 
         void updatePixel(SPGL::Size x, SPGL::Size y) {
@@ -65,6 +108,29 @@ namespace sb {
         void updatePixel(SPGL::Size i) {
             updatePixel(i % image.width(), i / image.width());
         }
+
+        // Number of stride x stride blocks needed to cover the image
+        SPGL::Size blocks(SPGL::Size stride) const {
+            return ((image.width() + stride - 1) / stride) * ((image.height() + stride - 1) / stride);
+        }
+
+        // March the center of a block and fill the whole block with it
+        void updateBlock(SPGL::Size x, SPGL::Size y, SPGL::Size stride) {
+            const SPGL::Size w = std::min(x + stride, image.width());
+            const SPGL::Size h = std::min(y + stride, image.height());
+            const SPGL::Color color = getPixel((x + w) / 2, (y + h) / 2);
+
+            for(SPGL::Size by = y; by < h; ++by) {
+                for(SPGL::Size bx = x; bx < w; ++bx) {
+                    image(bx, by) = color;
+                }
+            }
+        }
+
+        void updateBlock(SPGL::Size i, SPGL::Size stride) {
+            const SPGL::Size columns = (image.width() + stride - 1) / stride;
+            updateBlock((i % columns) * stride, (i / columns) * stride, stride);
+        }
     };
 
 }
@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <functional>
+#include <random>
 #include "vec3.hpp"
 #include "mat3.hpp"
 
@@ -12,76 +13,158 @@ namespace sb {
 
 
     class SDF {
+    public: // Distance Functions
+        static FloatT sphere(const Vec3d& pos, const FloatT radius) {
+            return pos.mag() - radius;
+        }
+
+        static FloatT box(const Vec3d& pos, const Vec3d& size) {
+            Vec3d q = pos.abs() - size;
+            FloatT a = Vec3d(std::max(q.x, FloatT(0)), std::max(q.y, FloatT(0)), std::max(q.z, FloatT(0))).mag();
+            FloatT b = std::min(FloatT(0), std::max(q.x, std::max(q.y, q.z)));
+            return a + b;
+        }
+
+        // The normal must already be normalized
+        static FloatT plane(const Vec3d& pos, const Vec3d& normal, const FloatT h) {
+            return normal.dot(pos) + h;
+        }
+
+        static FloatT cylinder(const Vec3d& pos, const FloatT radius) {
+            return std::hypot(pos.x, pos.z) - radius;
+        }
+
+        static FloatT squilindar(const Vec3d& pos, const FloatT radius) {
+            return std::sqrt(std::hypot(pos.x * pos.x, pos.z * pos.z)) - radius;
+        }
+
+        static FloatT squircle(const Vec3d& pos, const FloatT radius) {
+            double x = pos.x; x *= x; x *= x;
+            double y = pos.y; y *= y; y *= y;
+            double z = pos.z; z *= z; z *= z;
+            return std::sqrt(std::sqrt(x + y + z)) - radius;
+        }
+
     public: // Static Constructors
         static SDF Sphere(const FloatT radius) {
             return SDF([=](const Vec3d& pos) {
-                return pos.mag() - radius;
+                return sphere(pos, radius);
             });
         }
 
         static SDF Box(const Vec3d size) {
             return SDF([=](const Vec3d& pos) {
-                Vec3d q = pos.abs() - size;
-                FloatT a = Vec3d(std::max(q.x, FloatT(0)), std::max(q.y, FloatT(0)), std::max(q.z, FloatT(0))).mag();
-                FloatT b = std::min(FloatT(0), std::max(q.x, std::max(q.y, q.z)));
-                return a + b;
+                return box(pos, size);
             });
         }
 
         static SDF Plane(const Vec3d normal, const FloatT h) {
             const Vec3d normed_normal = normal.norm();
             return SDF([=](const Vec3d& pos) {
-                return normed_normal.dot(pos) + h;
+                return plane(pos, normed_normal, h);
             });
         }
 
         static SDF Cylinder(const FloatT radius) {
             return SDF([=](const Vec3d& pos) {
-                return std::hypot(pos.x, pos.z) - radius;
+                return cylinder(pos, radius);
             });
         }
 
         static SDF Squilindar(const FloatT radius) {
             return SDF([=](const Vec3d& pos) {
-                return std::sqrt(std::hypot(pos.x * pos.x, pos.z * pos.z)) - radius;
+                return squilindar(pos, radius);
             });
         }
 
         static SDF Squircle(const FloatT radius) {
             return SDF([=](const Vec3d& pos) {
-                double x = pos.x; x *= x; x *= x;
-                double y = pos.y; y *= y; y *= y;
-                double z = pos.z; z *= z; z *= z;
-                return std::sqrt(std::sqrt(x + y + z)) - radius;
+                return squircle(pos, radius);
             });
         }
 
     private: // Variables
+        // Raw distance function, which may change faster than the true distance
         SDFBase _func;
 
+        // Bound on how fast _func can change per unit moved (its Lipschitz constant)
+        FloatT _lipschitz;
+        FloatT _inv_lipschitz;
+
     public: // Constructors
-        SDF(const SDFBase& func) : _func{func} {}
+        SDF(const SDFBase& func, FloatT lipschitz = 1.0) 
+            : _func{func}, _lipschitz{lipschitz}, _inv_lipschitz{FloatT(1.0) / lipschitz} {}
 
         SDF(const SDF&) = default;
         SDF& operator=(const SDF&) = default;
 
     public: // Operator Overloading (Passthrough)
+        // Distance that is always safe to step, the raw value divided by the bound
         FloatT operator()(const Vec3d& pos) const {
-            return _func(pos);
+            return _func(pos) * _inv_lipschitz;
         }
     
     public: // Functions
+        FloatT raw(const Vec3d& pos) const {
+            return _func(pos);
+        }
+
+        FloatT lipschitz() const {
+            return _lipschitz;
+        }
+
         Vec3d normal(const Vec3d& pos) const {
             static const Vec3d xyy(+1, -1, -1);
             static const Vec3d yyx(-1, -1, +1);
             static const Vec3d yxy(-1, +1, -1);
             static const Vec3d xxx(+1, +1, +1);
             
+            // Scaling does not change the direction, so skip the division
             return (
-                xyy * operator()(pos + NORM_EPS * xyy) += 
-                yyx * operator()(pos + NORM_EPS * yyx) += 
-                yxy * operator()(pos + NORM_EPS * yxy) += 
-                xxx * operator()(pos + NORM_EPS * xxx)).normalize();
+                xyy * raw(pos + NORM_EPS * xyy) += 
+                yyx * raw(pos + NORM_EPS * yyx) += 
+                yxy * raw(pos + NORM_EPS * yxy) += 
+                xxx * raw(pos + NORM_EPS * xxx)).normalize();
+        }
+
+        // Debugging aid: the largest rate of change seen between random pairs of
+        // points near center, relative to the tracked bound. Anything above 1
+        // means the bound is wrong and the marcher can step through surfaces.
+        FloatT checkLipschitz(const Vec3d& center, const FloatT radius, const int samples) const {
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<FloatT> unit(-1, 1);
+            const auto point = [&]() { return Vec3d(unit(rng), unit(rng), unit(rng)); };
+
+            FloatT worst = 0;
+            for(int i = 0; i < samples; ++i) {
+                const Vec3d a = center + radius * point();
+
+                // Mix of tiny and large separations to catch both kinds of error
+                const FloatT spacing = std::pow(FloatT(10), FloatT(-3) + FloatT(3) * (unit(rng) + 1) / 2);
+                const Vec3d b = a + spacing * point();
+
+                const FloatT dist = (b - a).mag();
+                if(dist <= 0) continue;
+                worst = std::max(worst, std::abs(operator()(a) - operator()(b)) / dist);
+            }
+
+            return worst;
+        }
+
+    private: // Helper Functions
+        // Children that share a bound can be combined raw, otherwise each one is
+        // scaled by its own bound first, which is tighter than using the larger one
+        template<typename Op>
+        static SDF combine(const SDF& lhs, const SDF& rhs, const Op& op) {
+            if(lhs._lipschitz == rhs._lipschitz) {
+                return SDF([=](const Vec3d& pos) {
+                    return op(lhs.raw(pos), rhs.raw(pos));
+                }, lhs._lipschitz);
+            }
+
+            return SDF([=](const Vec3d& pos) {
+                return op(lhs(pos), rhs(pos));
+            });
         }
 
     public: // Operator Overloading (Construction)
@@ -89,28 +172,28 @@ namespace sb {
         // Invert the shape
         friend SDF operator~(const SDF& a) {
             return SDF([=](const Vec3d& pos) {
-                return -a(pos);
-            });
+                return -a.raw(pos);
+            }, a._lipschitz);
         }
 
         // Union two shapes together
         friend SDF operator|(const SDF& lhs, const SDF& rhs) {
-            return SDF([=](const Vec3d& pos) {
-                return std::min(lhs(pos), rhs(pos));
+            return combine(lhs, rhs, [](FloatT a, FloatT b) {
+                return std::min(a, b);
             });
         }
 
         // Get the intersection of two shapes
         friend SDF operator&(const SDF& lhs, const SDF& rhs) {
-            return SDF([=](const Vec3d& pos) {
-                return std::max(lhs(pos), rhs(pos));
+            return combine(lhs, rhs, [](FloatT a, FloatT b) {
+                return std::max(a, b);
             });
         }
 
         // Subtract one shape from another
         friend SDF operator-(const SDF& lhs, const SDF& rhs) {
-            return SDF([=](const Vec3d& pos) {
-                return std::max(lhs(pos), -rhs(pos));
+            return combine(lhs, rhs, [](FloatT a, FloatT b) {
+                return std::max(a, -b);
             });
         }
         
@@ -118,29 +201,26 @@ namespace sb {
         friend SDF operator+(const Vec3d& lhs, const SDF& rhs) { return rhs + lhs; }
         friend SDF operator+(const SDF& lhs, const Vec3d& rhs) {
             return SDF([=](const Vec3d& pos) {
-                return lhs(pos - rhs);
-            });
+                return lhs.raw(pos - rhs);
+            }, lhs._lipschitz);
         }
 
         // Subtract position from the shape
         friend SDF operator-(const SDF& lhs, const Vec3d& rhs) {
             return SDF([=](const Vec3d& pos) {
-                return lhs(pos + rhs);
-            });
+                return lhs.raw(pos + rhs);
+            }, lhs._lipschitz);
         }
 
+        // Transform a shape, moving by one unit moves at most mat.norm() units in the shape
         friend SDF operator*(const Mat3d& lhs, const SDF& rhs) {
             const Mat3d mat = lhs.inv();
-            const FloatT x_dist = std::sqrt(mat[0][0] * mat[0][0] + mat[1][0] * mat[1][0] + mat[2][0] * mat[2][0]);
-            const FloatT y_dist = std::sqrt(mat[0][1] * mat[0][1] + mat[1][1] * mat[1][1] + mat[2][1] * mat[2][1]);
-            const FloatT z_dist = std::sqrt(mat[0][2] * mat[0][2] + mat[1][2] * mat[1][2] + mat[2][2] * mat[2][2]);
-            const FloatT max_dist = std::max(x_dist, std::max(y_dist, z_dist));
             return SDF([=](const Vec3d& pos) {
-                return rhs(mat * pos) / max_dist;
-            });
+                return rhs.raw(mat * pos);
+            }, rhs._lipschitz * mat.norm());
         }
 
-        // Add radius to the SDF function
+        // Add radius to the SDF function, this has to be done in real distances
         friend SDF operator+(const FloatT lhs, const SDF& rhs) { return rhs + lhs; }
         friend SDF operator+(const SDF& lhs, const FloatT rhs) {
             return SDF([=](const Vec3d& pos) {
@@ -155,20 +235,20 @@ namespace sb {
             });
         }
 
-        // Stretch Shape by a certain vector
+        // Stretch Shape by a certain vector, the shortest axis changes the fastest
         friend SDF operator*(const Vec3d& lhs, const SDF& rhs) { return rhs * lhs; }
         friend SDF operator*(const SDF& lhs, const Vec3d& rhs) {
             return SDF([=](const Vec3d& pos) {
-                return lhs(pos / rhs) * std::min(rhs.x, std::min(rhs.y, rhs.z));
-            });
+                return lhs.raw(pos / rhs);
+            }, lhs._lipschitz / std::min(rhs.x, std::min(rhs.y, rhs.z)));
         }
 
         // Scale a Shape
         friend SDF operator*(const FloatT& lhs, const SDF& rhs) { return rhs * lhs; }
         friend SDF operator*(const SDF& lhs, const FloatT& rhs) {
             return SDF([=](const Vec3d& pos) {
-                return lhs(pos / rhs) * rhs;
-            });
+                return lhs.raw(pos / rhs) * rhs;
+            }, lhs._lipschitz);
         }
     };
 
@@ -0,0 +1,130 @@
+#ifndef SAM_B_SHADOWS_HPP
+#define SAM_B_SHADOWS_HPP 1
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include "constants.hpp"
+#include "vec3.hpp"
+
+namespace sb {
+
+    // Remembers whether a light was visible from a spot in the world, so static
+    // scenes only march each shadow ray once instead of once per frame.
+    //
+    // Hit positions are snapped to cells of SHADOW_CACHE_CELL, and each (cell,
+    // light) pair is packed with its answer into one 64 bit word. Words live in
+    // a fixed size table of SHADOW_CACHE_WAYS way sets, so memory never grows,
+    // and a miss replaces the least recently used word of its set. Every word
+    // is read and written atomically, so no locks are needed: two threads
+    // filling the same set at once can only cost an extra march.
+    //
+    // The cache does not know when the scene changes, call clear() if the SDF
+    // or any light moves.
+    class ShadowCache {
+    private: // Constants
+        static constexpr int CELL_BITS = 19;
+        static constexpr int LIGHT_BITS = 6;
+        static constexpr std::int64_t CELL_OFFSET = std::int64_t(1) << (CELL_BITS - 1);
+
+    private: // Variables
+        std::size_t _sets;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> _words;
+        std::unique_ptr<std::atomic<std::uint32_t>[]> _used;
+
+        std::atomic<std::uint32_t> _clock{1};
+        std::atomic<std::size_t> _hits{0};
+        std::atomic<std::size_t> _misses{0};
+
+    public: // Constructor
+        ShadowCache(std::size_t entries = SHADOW_CACHE_ENTRIES) 
+            : _sets{std::max<std::size_t>(1, entries / SHADOW_CACHE_WAYS)}
+            , _words{new std::atomic<std::uint64_t>[_sets * SHADOW_CACHE_WAYS]}
+            , _used{new std::atomic<std::uint32_t>[_sets * SHADOW_CACHE_WAYS]} {
+            clear();
+        }
+
+        ShadowCache(const ShadowCache&) = delete;
+        ShadowCache& operator=(const ShadowCache&) = delete;
+
+    public: // Getters
+        std::size_t hits() const {
+            return _hits.load(std::memory_order_relaxed);
+        }
+
+        std::size_t misses() const {
+            return _misses.load(std::memory_order_relaxed);
+        }
+
+    public: // Functions
+        // Returns the cached visibility of light from pos, or calls march() to find it
+        template<typename March>
+        bool visible(std::size_t light, const Vec3d& pos, const March& march) {
+            const std::uint64_t key = pack(light, pos);
+            if(key == 0) return march();
+
+            const std::size_t set = std::size_t(mix(key) % _sets) * SHADOW_CACHE_WAYS;
+            const std::uint32_t now = _clock.load(std::memory_order_relaxed);
+
+            std::size_t oldest = set;
+            for(std::size_t i = set; i < set + SHADOW_CACHE_WAYS; ++i) {
+                const std::uint64_t word = _words[i].load(std::memory_order_relaxed);
+                if((word >> 1) == key) {
+                    _used[i].store(now, std::memory_order_relaxed);
+                    _hits.fetch_add(1, std::memory_order_relaxed);
+                    return word & 1;
+                }
+
+                if(_used[i].load(std::memory_order_relaxed) < _used[oldest].load(std::memory_order_relaxed)) {
+                    oldest = i;
+                }
+            }
+
+            _misses.fetch_add(1, std::memory_order_relaxed);
+            const bool result = march();
+
+            _words[oldest].store((key << 1) | std::uint64_t(result), std::memory_order_relaxed);
+            _used[oldest].store(_clock.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+            return result;
+        }
+
+        // Only call this while nothing is rendering
+        void clear() {
+            for(std::size_t i = 0; i < _sets * SHADOW_CACHE_WAYS; ++i) {
+                _words[i].store(0, std::memory_order_relaxed);
+                _used[i].store(0, std::memory_order_relaxed);
+            }
+            _clock = 1;
+            _hits = 0;
+            _misses = 0;
+        }
+
+    private: // Helper Functions
+        // Cell x, y, z and light + 1 packed into 63 bits, 0 if it does not fit
+        static std::uint64_t pack(std::size_t light, const Vec3d& pos) {
+            const std::int64_t x = std::int64_t(std::floor(pos.x / SHADOW_CACHE_CELL)) + CELL_OFFSET;
+            const std::int64_t y = std::int64_t(std::floor(pos.y / SHADOW_CACHE_CELL)) + CELL_OFFSET;
+            const std::int64_t z = std::int64_t(std::floor(pos.z / SHADOW_CACHE_CELL)) + CELL_OFFSET;
+
+            const std::int64_t limit = std::int64_t(1) << CELL_BITS;
+            if(x < 0 || y < 0 || z < 0 || limit <= x || limit <= y || limit <= z) return 0;
+            if((std::size_t(1) << LIGHT_BITS) - 1 <= light) return 0;
+
+            return (((((std::uint64_t(light) + 1) << CELL_BITS | std::uint64_t(x)) << CELL_BITS) | std::uint64_t(y)) << CELL_BITS) | std::uint64_t(z);
+        }
+
+        static std::uint64_t mix(std::uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xFF51AFD7ED558CCDull;
+            h ^= h >> 33;
+            h *= 0xC4CEB9FE1A85EC53ull;
+            return h ^ (h >> 33);
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef SAM_B_TRACE_HPP
+#define SAM_B_TRACE_HPP 1
+
+// Opt in timeline profiling, written out as Chrome trace JSON
+// (open it in chrome://tracing or https://ui.perfetto.dev).
+//
+//     SB_TRACE=1  frames, tiles, bands and presentation
+//     SB_TRACE=2  also every primary ray, shadow ray and reflection
+//
+// Each process writes its own file, with its pid added before the extension.
+// When SB_TRACE is not defined every macro expands to nothing.
+
+#if defined(SB_TRACE) && 0 < SB_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "constants.hpp"
+
+namespace sb {
+
+    struct TraceEvent {
+        const char* name;
+        std::uint64_t begin;
+        std::uint64_t end;
+        std::int64_t arg;
+        int tid;
+    };
+
+    // Events of one thread. Only the owning thread writes to it, so recording takes no locks
+    struct TraceBuffer {
+        int tid = 0;
+        bool free = false;
+        std::size_t dropped = 0;
+        std::vector<TraceEvent> events;
+    };
+
+    class Trace {
+    public: // Functions
+        // Nanoseconds since the first call
+        static std::uint64_t now() {
+            static const auto epoch = std::chrono::steady_clock::now();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+        }
+
+        // Threads that share a tid show up as one row in the trace viewer
+        static void setThread(int tid) {
+            local().tid = tid;
+        }
+
+        // Ray events stop being recorded once a thread has TRACE_BUFFER_EVENTS,
+        // so the coarse spans around them are never lost
+        static void record(const char* name, std::uint64_t begin, std::uint64_t end, std::int64_t arg, bool ray) {
+            TraceBuffer& buffer = local();
+            if(!ray || buffer.events.size() < TRACE_BUFFER_EVENTS) {
+                buffer.events.push_back(TraceEvent{name, begin, end, arg, buffer.tid});
+            } else {
+                buffer.dropped += 1;
+            }
+        }
+
+        // Only call this while no other thread is recording
+        static bool flush(const char* path) {
+            std::lock_guard<std::mutex> lock(mutex());
+
+            // Forked workers share the cwd, so they must not write over each other
+            std::string name = path;
+            const std::size_t dot = name.rfind('.');
+            name.insert(dot == std::string::npos ? name.size() : dot, "." + std::to_string(::getpid()));
+
+            std::FILE* file = std::fopen(name.c_str(), "w");
+            if(file == nullptr) return false;
+
+            std::size_t dropped = 0;
+            const char* separator = "";
+            std::fprintf(file, "{\"traceEvents\":[\n");
+            for(const auto& buffer : buffers()) {
+                dropped += buffer->dropped;
+                for(const TraceEvent& e : buffer->events) {
+                    std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg\":%lld}}",
+                        separator, e.name, int(::getpid()), e.tid, e.begin / 1000.0, (e.end - e.begin) / 1000.0, (long long)e.arg);
+                    separator = ",\n";
+                }
+                buffer->events.clear();
+                buffer->dropped = 0;
+            }
+            std::fprintf(file, "\n]}\n");
+
+            if(0 < dropped) {
+                std::fprintf(stderr, "Trace dropped %zu events, raise TRACE_BUFFER_EVENTS\n", dropped);
+            }
+
+            std::fprintf(stderr, "Trace written to %s\n", name.c_str());
+            return std::fclose(file) == 0;
+        }
+
+    private: // Helper Functions
+        static std::mutex& mutex() {
+            static std::mutex m;
+            return m;
+        }
+
+        static std::vector<std::unique_ptr<TraceBuffer>>& buffers() {
+            static std::vector<std::unique_ptr<TraceBuffer>> b;
+            return b;
+        }
+
+        // Hands the buffer to the next thread once this one exits, so
+        // spawning threads every frame does not grow the buffer list
+        struct Owner {
+            TraceBuffer* buffer;
+
+            Owner() {
+                std::lock_guard<std::mutex> lock(mutex());
+                for(const auto& b : buffers()) {
+                    if(b->free) {
+                        b->free = false;
+                        buffer = b.get();
+                        return;
+                    }
+                }
+                buffers().push_back(std::make_unique<TraceBuffer>());
+                buffer = buffers().back().get();
+            }
+
+            ~Owner() {
+                std::lock_guard<std::mutex> lock(mutex());
+                buffer->free = true;
+            }
+        };
+
+        static TraceBuffer& local() {
+            thread_local Owner owner;
+            return *owner.buffer;
+        }
+    };
+
+    class TraceSpan {
+    private: // Variables
+        const char* _name;
+        std::int64_t _arg;
+        std::uint64_t _begin;
+        bool _ray;
+
+    public: // Constructor
+        TraceSpan(const char* name, std::int64_t arg = 0, bool ray = false)
+            : _name{name}, _arg{arg}, _begin{Trace::now()}, _ray{ray} {}
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+        ~TraceSpan() {
+            Trace::record(_name, _begin, Trace::now(), _arg, _ray);
+        }
+    };
+
+    class TraceRaySpan : public TraceSpan {
+    public: // Constructor
+        TraceRaySpan(const char* name, std::int64_t arg = 0)
+            : TraceSpan(name, arg, true) {}
+    };
+
+}
+
+#define SB_TRACE_JOIN2(a, b) a##b
+#define SB_TRACE_JOIN(a, b) SB_TRACE_JOIN2(a, b)
+
+#define SB_TRACE_SPAN(...) ::sb::TraceSpan SB_TRACE_JOIN(sb_trace_span_, __LINE__)(__VA_ARGS__)
+#define SB_TRACE_THREAD(tid) ::sb::Trace::setThread(tid)
+#define SB_TRACE_FLUSH(path) ::sb::Trace::flush(path)
+
+#if 1 < SB_TRACE
+#define SB_TRACE_RAY(...) ::sb::TraceRaySpan SB_TRACE_JOIN(sb_trace_ray_, __LINE__)(__VA_ARGS__)
+#else
+#define SB_TRACE_RAY(...) ((void)0)
+#endif
+
+#else
+
+#define SB_TRACE_SPAN(...) ((void)0)
+#define SB_TRACE_THREAD(tid) ((void)0)
+#define SB_TRACE_FLUSH(path) ((void)0)
+#define SB_TRACE_RAY(...) ((void)0)
+
+#endif
+
+#endif